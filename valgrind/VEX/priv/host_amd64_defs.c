@@ -563,6 +563,18 @@ const HChar* showAMD64SseOp ( AMD64SseOp op ) {
       case Asse_CMPGT8S:  return "pcmpgtb";
       case Asse_CMPGT16S: return "pcmpgtw";
       case Asse_CMPGT32S: return "pcmpgtd";
+      case Asse_MUL32:    return "pmulld";
+      case Asse_MAX32S:   return "pmaxsd";
+      case Asse_MIN32S:   return "pminsd";
+      case Asse_MAX32U:   return "pmaxud";
+      case Asse_MIN32U:   return "pminud";
+      case Asse_MAX16U:   return "pmaxuw";
+      case Asse_MIN16U:   return "pminuw";
+      case Asse_MAX8S:    return "pmaxsb";
+      case Asse_MIN8S:    return "pminsb";
+      case Asse_CMPEQ64:  return "pcmpeqq";
+      case Asse_CMPGT64S: return "pcmpgtq";
+      case Asse_PACKUSD:  return "packusdw";
       case Asse_SHL16:    return "psllw";
       case Asse_SHL32:    return "pslld";
       case Asse_SHL64:    return "psllq";
@@ -3735,6 +3747,18 @@ Int emit_AMD64Instr ( /*MB_MOD*/Bool* is_profInc,
          case Asse_UNPCKLW:  XX(0x66); XX(rex); XX(0x0F); XX(0x61); break;
          case Asse_UNPCKLD:  XX(0x66); XX(rex); XX(0x0F); XX(0x62); break;
          case Asse_UNPCKLQ:  XX(0x66); XX(rex); XX(0x0F); XX(0x6C); break;
+         case Asse_MUL32:    XX(0x66); XX(rex); XX(0x0F); XX(0x38); XX(0x40); break;
+         case Asse_MAX32S:   XX(0x66); XX(rex); XX(0x0F); XX(0x38); XX(0x3D); break;
+         case Asse_MIN32S:   XX(0x66); XX(rex); XX(0x0F); XX(0x38); XX(0x39); break;
+         case Asse_MAX32U:   XX(0x66); XX(rex); XX(0x0F); XX(0x38); XX(0x3F); break;
+         case Asse_MIN32U:   XX(0x66); XX(rex); XX(0x0F); XX(0x38); XX(0x3B); break;
+         case Asse_MAX16U:   XX(0x66); XX(rex); XX(0x0F); XX(0x38); XX(0x3E); break;
+         case Asse_MIN16U:   XX(0x66); XX(rex); XX(0x0F); XX(0x38); XX(0x3A); break;
+         case Asse_MAX8S:    XX(0x66); XX(rex); XX(0x0F); XX(0x38); XX(0x3C); break;
+         case Asse_MIN8S:    XX(0x66); XX(rex); XX(0x0F); XX(0x38); XX(0x38); break;
+         case Asse_CMPEQ64:  XX(0x66); XX(rex); XX(0x0F); XX(0x38); XX(0x29); break;
+         case Asse_CMPGT64S: XX(0x66); XX(rex); XX(0x0F); XX(0x38); XX(0x37); break;
+         case Asse_PACKUSD:  XX(0x66); XX(rex); XX(0x0F); XX(0x38); XX(0x2B); break;
          default: goto bad;
       }
       p = doAMode_R_enc_enc(p, vregEnc3210(i->Ain.SseReRg.dst),
@@ -335,6 +335,12 @@ typedef
       Asse_MIN8U,
       Asse_CMPEQ8, Asse_CMPEQ16, Asse_CMPEQ32,
       Asse_CMPGT8S, Asse_CMPGT16S, Asse_CMPGT32S,
+      /* SSE4.1 / SSE4.2 only */
+      Asse_MUL32,
+      Asse_MAX32S, Asse_MIN32S, Asse_MAX32U, Asse_MIN32U,
+      Asse_MAX16U, Asse_MIN16U, Asse_MAX8S, Asse_MIN8S,
+      Asse_CMPEQ64, Asse_CMPGT64S,
+      Asse_PACKUSD,
       Asse_SHL16, Asse_SHL32, Asse_SHL64,
       Asse_SHR16, Asse_SHR32, Asse_SHR64,
       Asse_SAR16, Asse_SAR32, 
@@ -165,6 +165,14 @@ typedef
    ISelEnv;
 
 
+/* Can SSE4.1 and SSE4.2 integer instructions be used, rather than
+   calling the generic SIMD helpers?  There is no separate hwcap for
+   them, but every AVX-capable host has SSE4.2. */
+static Bool hostHasSSE4 ( ISelEnv* env )
+{
+   return toBool(env->hwcaps & VEX_HWCAPS_AMD64_AVX);
+}
+
 static HReg lookupIRTemp ( ISelEnv* env, IRTemp tmp )
 {
    vassert(tmp >= 0);
@@ -3520,31 +3528,68 @@ static HReg iselVecExpr_wrk ( ISelEnv* env, IRExpr* e )
          return dst;
       }
 
-      case Iop_Mul32x4:    fn = (HWord)h_generic_calc_Mul32x4;
+      case Iop_Mul32x4:    if (hostHasSSE4(env)) {
+                              op = Asse_MUL32; goto do_SseReRg;
+                           }
+                           fn = (HWord)h_generic_calc_Mul32x4;
                            goto do_SseAssistedBinary;
-      case Iop_Max32Sx4:   fn = (HWord)h_generic_calc_Max32Sx4;
+      case Iop_Max32Sx4:   if (hostHasSSE4(env)) {
+                              op = Asse_MAX32S; goto do_SseReRg;
+                           }
+                           fn = (HWord)h_generic_calc_Max32Sx4;
                            goto do_SseAssistedBinary;
-      case Iop_Min32Sx4:   fn = (HWord)h_generic_calc_Min32Sx4;
+      case Iop_Min32Sx4:   if (hostHasSSE4(env)) {
+                              op = Asse_MIN32S; goto do_SseReRg;
+                           }
+                           fn = (HWord)h_generic_calc_Min32Sx4;
                            goto do_SseAssistedBinary;
-      case Iop_Max32Ux4:   fn = (HWord)h_generic_calc_Max32Ux4;
+      case Iop_Max32Ux4:   if (hostHasSSE4(env)) {
+                              op = Asse_MAX32U; goto do_SseReRg;
+                           }
+                           fn = (HWord)h_generic_calc_Max32Ux4;
                            goto do_SseAssistedBinary;
-      case Iop_Min32Ux4:   fn = (HWord)h_generic_calc_Min32Ux4;
+      case Iop_Min32Ux4:   if (hostHasSSE4(env)) {
+                              op = Asse_MIN32U; goto do_SseReRg;
+                           }
+                           fn = (HWord)h_generic_calc_Min32Ux4;
                            goto do_SseAssistedBinary;
-      case Iop_Max16Ux8:   fn = (HWord)h_generic_calc_Max16Ux8;
+      case Iop_Max16Ux8:   if (hostHasSSE4(env)) {
+                              op = Asse_MAX16U; goto do_SseReRg;
+                           }
+                           fn = (HWord)h_generic_calc_Max16Ux8;
                            goto do_SseAssistedBinary;
-      case Iop_Min16Ux8:   fn = (HWord)h_generic_calc_Min16Ux8;
+      case Iop_Min16Ux8:   if (hostHasSSE4(env)) {
+                              op = Asse_MIN16U; goto do_SseReRg;
+                           }
+                           fn = (HWord)h_generic_calc_Min16Ux8;
                            goto do_SseAssistedBinary;
-      case Iop_Max8Sx16:   fn = (HWord)h_generic_calc_Max8Sx16;
+      case Iop_Max8Sx16:   if (hostHasSSE4(env)) {
+                              op = Asse_MAX8S; goto do_SseReRg;
+                           }
+                           fn = (HWord)h_generic_calc_Max8Sx16;
                            goto do_SseAssistedBinary;
-      case Iop_Min8Sx16:   fn = (HWord)h_generic_calc_Min8Sx16;
+      case Iop_Min8Sx16:   if (hostHasSSE4(env)) {
+                              op = Asse_MIN8S; goto do_SseReRg;
+                           }
+                           fn = (HWord)h_generic_calc_Min8Sx16;
                            goto do_SseAssistedBinary;
-      case Iop_CmpEQ64x2:  fn = (HWord)h_generic_calc_CmpEQ64x2;
+      case Iop_CmpEQ64x2:  if (hostHasSSE4(env)) {
+                              op = Asse_CMPEQ64; goto do_SseReRg;
+                           }
+                           fn = (HWord)h_generic_calc_CmpEQ64x2;
                            goto do_SseAssistedBinary;
-      case Iop_CmpGT64Sx2: fn = (HWord)h_generic_calc_CmpGT64Sx2;
+      case Iop_CmpGT64Sx2: if (hostHasSSE4(env)) {
+                              op = Asse_CMPGT64S; goto do_SseReRg;
+                           }
+                           fn = (HWord)h_generic_calc_CmpGT64Sx2;
                            goto do_SseAssistedBinary;
       case Iop_Perm32x4:   fn = (HWord)h_generic_calc_Perm32x4;
                            goto do_SseAssistedBinary;
       case Iop_QNarrowBin32Sto16Ux8:
+                           if (hostHasSSE4(env)) {
+                              op = Asse_PACKUSD; arg1isEReg = True;
+                              goto do_SseReRg;
+                           }
                            fn = (HWord)h_generic_calc_QNarrowBin32Sto16Ux8;
                            goto do_SseAssistedBinary;
       case Iop_NarrowBin16to8x16:
@@ -4008,27 +4053,60 @@ static void iselDVecExpr_wrk ( /*OUT*/HReg* rHi, /*OUT*/HReg* rLo,
          return;
       }
 
-      case Iop_Mul32x8:    fn = (HWord)h_generic_calc_Mul32x4;
+      case Iop_Mul32x8:    if (hostHasSSE4(env)) {
+                              op = Asse_MUL32; goto do_SseReRg;
+                           }
+                           fn = (HWord)h_generic_calc_Mul32x4;
                            goto do_SseAssistedBinary;
-      case Iop_Max32Sx8:   fn = (HWord)h_generic_calc_Max32Sx4;
+      case Iop_Max32Sx8:   if (hostHasSSE4(env)) {
+                              op = Asse_MAX32S; goto do_SseReRg;
+                           }
+                           fn = (HWord)h_generic_calc_Max32Sx4;
                            goto do_SseAssistedBinary;
-      case Iop_Min32Sx8:   fn = (HWord)h_generic_calc_Min32Sx4;
+      case Iop_Min32Sx8:   if (hostHasSSE4(env)) {
+                              op = Asse_MIN32S; goto do_SseReRg;
+                           }
+                           fn = (HWord)h_generic_calc_Min32Sx4;
                            goto do_SseAssistedBinary;
-      case Iop_Max32Ux8:   fn = (HWord)h_generic_calc_Max32Ux4;
+      case Iop_Max32Ux8:   if (hostHasSSE4(env)) {
+                              op = Asse_MAX32U; goto do_SseReRg;
+                           }
+                           fn = (HWord)h_generic_calc_Max32Ux4;
                            goto do_SseAssistedBinary;
-      case Iop_Min32Ux8:   fn = (HWord)h_generic_calc_Min32Ux4;
+      case Iop_Min32Ux8:   if (hostHasSSE4(env)) {
+                              op = Asse_MIN32U; goto do_SseReRg;
+                           }
+                           fn = (HWord)h_generic_calc_Min32Ux4;
                            goto do_SseAssistedBinary;
-      case Iop_Max16Ux16:  fn = (HWord)h_generic_calc_Max16Ux8;
+      case Iop_Max16Ux16:  if (hostHasSSE4(env)) {
+                              op = Asse_MAX16U; goto do_SseReRg;
+                           }
+                           fn = (HWord)h_generic_calc_Max16Ux8;
                            goto do_SseAssistedBinary;
-      case Iop_Min16Ux16:  fn = (HWord)h_generic_calc_Min16Ux8;
+      case Iop_Min16Ux16:  if (hostHasSSE4(env)) {
+                              op = Asse_MIN16U; goto do_SseReRg;
+                           }
+                           fn = (HWord)h_generic_calc_Min16Ux8;
                            goto do_SseAssistedBinary;
-      case Iop_Max8Sx32:   fn = (HWord)h_generic_calc_Max8Sx16;
+      case Iop_Max8Sx32:   if (hostHasSSE4(env)) {
+                              op = Asse_MAX8S; goto do_SseReRg;
+                           }
+                           fn = (HWord)h_generic_calc_Max8Sx16;
                            goto do_SseAssistedBinary;
-      case Iop_Min8Sx32:   fn = (HWord)h_generic_calc_Min8Sx16;
+      case Iop_Min8Sx32:   if (hostHasSSE4(env)) {
+                              op = Asse_MIN8S; goto do_SseReRg;
+                           }
+                           fn = (HWord)h_generic_calc_Min8Sx16;
                            goto do_SseAssistedBinary;
-      case Iop_CmpEQ64x4:  fn = (HWord)h_generic_calc_CmpEQ64x2;
+      case Iop_CmpEQ64x4:  if (hostHasSSE4(env)) {
+                              op = Asse_CMPEQ64; goto do_SseReRg;
+                           }
+                           fn = (HWord)h_generic_calc_CmpEQ64x2;
                            goto do_SseAssistedBinary;
-      case Iop_CmpGT64Sx4: fn = (HWord)h_generic_calc_CmpGT64Sx2;
+      case Iop_CmpGT64Sx4: if (hostHasSSE4(env)) {
+                              op = Asse_CMPGT64S; goto do_SseReRg;
+                           }
+                           fn = (HWord)h_generic_calc_CmpGT64Sx2;
                            goto do_SseAssistedBinary;
       do_SseAssistedBinary: {
          /* RRRufff!  RRRufff code is what we're generating here.  Oh
@@ -85,6 +85,18 @@ typedef
    RRegLR;
 
 
+/* For each instruction, and for each vreg it mentions (in the same
+   order as HRegUsage.vRegs), the number of the next instruction which
+   mentions that vreg, or the number of instructions if there is none.
+   Computed once, in a backwards pass over the HRegUsage records, and
+   used to keep track of the next use of each vreg while allocating. */
+typedef
+   struct {
+      Short next[N_HREGUSAGE_VREGS];
+   }
+   VRegNextUse;
+
+
 /* An array of the following structs (rreg_state) comprises the
    running state of the allocator.  It indicates what the current
    disposition of each allocatable real register is.  The array gets
@@ -144,27 +156,27 @@ typedef
 #define IS_VALID_RREGNO(_zz) ((_zz) >= 0 && (_zz) < n_rregs)
 
 
-/* Search forward from some given point in the incoming instruction
-   sequence.  Point is to select a virtual register to spill, by
-   finding the vreg which is mentioned as far ahead as possible, in
-   the hope that this will minimise the number of consequent reloads.
+/* Select a virtual register to spill, by finding the vreg which is
+   mentioned as far ahead as possible, in the hope that this will
+   minimise the number of consequent reloads.
 
-   Only do the search for vregs which are Bound in the running state,
-   and for which the .is_spill_cand field is set.  This allows the
-   caller to arbitrarily restrict the set of spill candidates to be
-   considered.
+   Only consider vregs which are Bound in the running state, and for
+   which the .is_spill_cand field is set.  This allows the caller to
+   arbitrarily restrict the set of spill candidates to be considered.
 
-   To do this we don't actually need to see the incoming instruction
-   stream.  Rather, what we need us the HRegUsage records for the
-   incoming instruction stream.  Hence that is passed in.
+   This used to search forwards through the HRegUsage records for
+   each candidate, which made allocation quadratic in the block size
+   when there was a lot of spilling.  Instead the caller keeps
+   vreg_next_use[] up to date, giving for each vreg the number of the
+   next instruction which mentions it.  Since no spill candidate is
+   mentioned by the current instruction, that is the same answer the
+   search would find.
 
    Returns an index into the state array indicating the (v,r) pair to
    spill, or -1 if none was found.  */
 static
 Int findMostDistantlyMentionedVReg ( 
-   HRegUsage*   reg_usages_in,
-   Int          search_from_instr,
-   Int          num_instrs,
+   const Short* vreg_next_use,
    RRegState*   state,
    Int          n_state
 )
@@ -172,15 +184,11 @@ Int findMostDistantlyMentionedVReg (
    Int k, m;
    Int furthest_k = -1;
    Int furthest   = -1;
-   vassert(search_from_instr >= 0);
    for (k = 0; k < n_state; k++) {
       if (!state[k].is_spill_cand)
          continue;
       vassert(state[k].disp == Bound);
-      for (m = search_from_instr; m < num_instrs; m++) {
-         if (HRegUsage__contains(&reg_usages_in[m], state[k].vreg))
-            break;
-      }
+      m = vreg_next_use[hregIndex(state[k].vreg)];
       if (m > furthest) {
          furthest   = m;
          furthest_k = k;
@@ -389,7 +397,11 @@ HInstrArray* doRegisterAllocation (
    void (*ppReg) ( HReg ),
 
    /* 32/64bit mode */
-   Bool mode64
+   Bool mode64,
+
+   /* Stats only: the number of spills and reloads generated. */
+   UInt* n_spills,
+   UInt* n_reloads
 )
 {
 #  define N_SPILL64S  (LibVEX_N_SPILL_BYTES / 8)
@@ -419,6 +431,12 @@ HInstrArray* doRegisterAllocation (
       sometimes by the direct-reload optimisation. */
    HRegUsage* reg_usage_arr; /* [0 .. instrs_in->arr_used-1] */
 
+   /* Next-use chains through reg_usage_arr, and for each vreg, the
+      first instruction at or after the current one which mentions
+      it.  Used to choose spill candidates in constant time. */
+   VRegNextUse* next_use_arr;  /* [0 .. instrs_in->arr_used-1] */
+   Short*       vreg_next_use; /* [0 .. n_vregs-1] */
+
    /* Used when constructing vreg_lrs (for allocating stack
       slots). */
    Short ss_busy_until_before[N_SPILL64S];
@@ -446,6 +464,7 @@ HInstrArray* doRegisterAllocation (
    /* Sanity checks are expensive.  They are only done periodically,
       not at each insn processed. */
    Bool do_sanity_check;
+   Int  sanity_check_interval;
 
    vassert(0 == (guest_sizeB % LibVEX_GUEST_STATE_ALIGN));
    vassert(0 == (LibVEX_N_SPILL_BYTES % LibVEX_GUEST_STATE_ALIGN));
@@ -977,6 +996,36 @@ HInstrArray* doRegisterAllocation (
       correctly set up our running state, which tracks the status of
       each real register. */
 
+   /* Build the next-use chains, walking backwards so that
+      vreg_next_use[] holds the first mention of each vreg at or after
+      instruction ii+1 while instruction ii is visited.  At the end it
+      holds the first mention of each vreg, which is the right initial
+      state for the main loop. */
+   next_use_arr
+      = LibVEX_Alloc_inline(sizeof(VRegNextUse) * instrs_in->arr_used);
+   vreg_next_use
+      = LibVEX_Alloc_inline(sizeof(Short) * (n_vregs > 0 ? n_vregs : 1));
+   for (Int j = 0; j < n_vregs; j++)
+      vreg_next_use[j] = toShort(instrs_in->arr_used);
+   for (Int ii = instrs_in->arr_used-1; ii >= 0; ii--) {
+      for (Int j = 0; j < reg_usage_arr[ii].n_vRegs; j++) {
+         Int k = hregIndex(reg_usage_arr[ii].vRegs[j]);
+         next_use_arr[ii].next[j] = vreg_next_use[k];
+         vreg_next_use[k] = toShort(ii);
+      }
+   }
+
+   /* Sanity checks 1 and 4 below cost time proportional to the number
+      of rreg live ranges and vregs, both of which grow with the block
+      size.  Doing them every 13 insns made allocation of large blocks
+      quadratic, so space them out further in large blocks. */
+   sanity_check_interval = instrs_in->arr_used / 16;
+   if (sanity_check_interval < 13)
+      sanity_check_interval = 13;
+
+   *n_spills  = 0;
+   *n_reloads = 0;
+
    /* ------ BEGIN: Process each insn in turn. ------ */
 
    for (Int ii = 0; ii < instrs_in->arr_used; ii++) {
@@ -993,13 +1042,13 @@ HInstrArray* doRegisterAllocation (
       /* ------------ Sanity checks ------------ */
 
       /* Sanity checks are expensive.  So they are done only once
-         every 13 instructions, and just before the last
-         instruction. */
+         every sanity_check_interval instructions, and just before the
+         last instruction. */
       do_sanity_check
          = toBool(
               False /* Set to True for sanity checking of all insns. */
               || ii == instrs_in->arr_used-1
-              || (ii > 0 && (ii % 13) == 0)
+              || (ii > 0 && (ii % sanity_check_interval) == 0)
            );
 
       if (do_sanity_check) {
@@ -1090,6 +1139,15 @@ HInstrArray* doRegisterAllocation (
 
       /* ------------ end of Sanity checks ------------ */
 
+      /* Move the next use of each vreg mentioned by this insn on to
+         its following mention.  This must be done before the
+         direct-reload optimisation below changes reg_usage_arr[ii]. */
+      for (Int j = 0; j < reg_usage_arr[ii].n_vRegs; j++) {
+         Int k = hregIndex(reg_usage_arr[ii].vRegs[j]);
+         vassert(IS_VALID_VREGNO(k));
+         vreg_next_use[k] = next_use_arr[ii].next[j];
+      }
+
       /* Do various optimisations pertaining to register coalescing
          and preferencing:
             MOV  v <-> v   coalescing (done here).
@@ -1227,6 +1285,7 @@ HInstrArray* doRegisterAllocation (
                   (*genSpill)( &spill1, &spill2, univ->regs[k],
                                vreg_lrs[m].spill_offset, mode64 );
                   vassert(spill1 || spill2); /* can't both be NULL */
+                  (*n_spills)++;
                   if (spill1)
                      EMIT_INSTR(spill1);
                   if (spill2)
@@ -1402,6 +1461,7 @@ HInstrArray* doRegisterAllocation (
                (*genReload)( &reload1, &reload2, univ->regs[k],
                              vreg_lrs[p].spill_offset, mode64 );
                vassert(reload1 || reload2); /* can't both be NULL */
+               (*n_reloads)++;
                if (reload1)
                   EMIT_INSTR(reload1);
                if (reload2)
@@ -1454,7 +1514,7 @@ HInstrArray* doRegisterAllocation (
             of consequent reloads required. */
          Int spillee
             = findMostDistantlyMentionedVReg ( 
-                 reg_usage_arr, ii+1, instrs_in->arr_used, rreg_state, n_rregs );
+                 vreg_next_use, rreg_state, n_rregs );
 
          if (spillee == -1) {
             /* Hmmmmm.  There don't appear to be any spill candidates.
@@ -1487,6 +1547,7 @@ HInstrArray* doRegisterAllocation (
             (*genSpill)( &spill1, &spill2, univ->regs[spillee],
                          vreg_lrs[m].spill_offset, mode64 );
             vassert(spill1 || spill2); /* can't both be NULL */
+            (*n_spills)++;
             if (spill1)
                EMIT_INSTR(spill1);
             if (spill2)
@@ -1513,6 +1574,7 @@ HInstrArray* doRegisterAllocation (
             (*genReload)( &reload1, &reload2, univ->regs[spillee],
                           vreg_lrs[m].spill_offset, mode64 );
             vassert(reload1 || reload2); /* can't both be NULL */
+            (*n_reloads)++;
             if (reload1)
                EMIT_INSTR(reload1);
             if (reload2)
@@ -475,7 +475,11 @@ HInstrArray* doRegisterAllocation (
    void (*ppReg) ( HReg ),
 
    /* 32/64bit mode */
-   Bool mode64
+   Bool mode64,
+
+   /* Stats only: the number of spills and reloads generated. */
+   UInt* n_spills,
+   UInt* n_reloads
 );
 
 
@@ -823,6 +823,9 @@ VexTranslateResult LibVEX_Translate ( VexTranslateArgs* vta )
    res.n_sc_extents   = 0;
    res.offs_profInc   = -1;
    res.n_guest_instrs = 0;
+   res.n_host_instrs  = 0;
+   res.n_spills       = 0;
+   res.n_reloads      = 0;
 
    /* yet more sanity checks ... */
    if (vta->arch_guest == vta->arch_host) {
@@ -1039,7 +1042,9 @@ VexTranslateResult LibVEX_Translate ( VexTranslateArgs* vta )
                                   isMove, getRegUsage, mapRegs, 
                                   genSpill, genReload, directReload, 
                                   guest_sizeB,
-                                  ppInstr, ppReg, mode64 );
+                                  ppInstr, ppReg, mode64,
+                                  &res.n_spills, &res.n_reloads );
+   res.n_host_instrs = rcode->arr_used;
 
    vexAllocSanityCheck();
 
@@ -587,6 +587,12 @@ typedef
       /* Stats only: the number of guest insns included in the
          translation.  It may be zero (!). */
       UInt n_guest_instrs;
+      /* Stats only: the number of host insns after register
+         allocation, and the number of spills and reloads the
+         register allocator had to insert. */
+      UInt n_host_instrs;
+      UInt n_spills;
+      UInt n_reloads;
    }
    VexTranslateResult;
 
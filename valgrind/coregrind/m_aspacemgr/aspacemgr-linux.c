@@ -332,6 +332,9 @@ static Addr aspacem_cStart = 0;
 // Where aspacem will start looking for Valgrind space
 static Addr aspacem_vStart = 0;
 
+// Has VG_(am_set_client_write_protect) ever removed write permission?
+static Bool client_pages_write_protected = False;
+
 
 #define AM_SANITY_CHECK                                      \
    do {                                                      \
@@ -894,6 +897,14 @@ static void sync_check_mapping_callback ( Addr addr, SizeT len, UInt prot,
          seg_prot |= VKI_PROT_READ;
       }
 
+      /* With --smc-check=mprotect, pages of writable client segments
+         that translations were taken from may have been
+         write-protected behind the client's back. */
+      if (client_pages_write_protected && nsegments[i].hasT
+          && (prot & VKI_PROT_WRITE) == 0) {
+         seg_prot &= ~VKI_PROT_WRITE;
+      }
+
       same = same
              && seg_prot == prot
              && (cmp_devino
@@ -2229,8 +2240,12 @@ Bool VG_(am_notify_mprotect)( Addr start, SizeT len, UInt prot )
    newW = toBool(prot & VKI_PROT_WRITE);
    newX = toBool(prot & VKI_PROT_EXEC);
 
-   /* Discard is needed if we're dumping X permission */
-   needDiscard = any_Ts_in_range( start, len ) && !newX;
+   /* Discard is needed if we're dumping X permission.  With
+      --smc-check=mprotect, it is also needed if the client is making
+      the pages writable: the kernel has just undone any write
+      protection of ours, so writes to the pages would go unnoticed. */
+   needDiscard = any_Ts_in_range( start, len )
+                 && (!newX || (newW && client_pages_write_protected));
 
    split_nsegments_lo_and_hi( start, start+len-1, &iLo, &iHi );
 
@@ -2636,6 +2651,32 @@ void* VG_(am_shadow_alloc)(SizeT size)
    return sr_isError(sres) ? NULL : (void*)sr_Res(sres);
 }
 
+/* Over-allocate by one huge page, then trim the mapping down to the
+   aligned part. */
+
+void* VG_(am_shadow_alloc_huge)(SizeT size)
+{
+   const SizeT align = VG_SHADOW_HUGE_SZB;
+   SysRes sres;
+   Addr   base, start;
+
+   aspacem_assert(size > 0 && (size % align) == 0);
+   sres = VG_(am_mmap_anon_float_valgrind)( size + align );
+   if (sr_isError(sres))
+      return NULL;
+   base  = sr_Res(sres);
+   start = VG_ROUNDUP(base, align);
+   if (start > base)
+      (void)VG_(am_munmap_valgrind)( base, start - base );
+   if (start < base + align)
+      (void)VG_(am_munmap_valgrind)( start + size, base + align - start );
+#  if defined(VGO_linux)
+   /* Only advice; THP may be disabled or unavailable. */
+   (void)VG_(do_syscall3)( __NR_madvise, start, size, VKI_MADV_HUGEPAGE );
+#  endif
+   return (void*)start;
+}
+
 /* Map a file at an unconstrained address for V, and update the
    segment array accordingly. Use the provided flags */
 
@@ -2883,6 +2924,37 @@ void VG_(am_set_segment_hasT)( Addr addr )
 }
 
 
+Bool VG_(am_set_client_write_protect)( Addr start, SizeT len,
+                                       Bool write_protect )
+{
+   Int    i;
+   UInt   prot;
+   SysRes sres;
+
+   aspacem_assert(VG_IS_PAGE_ALIGNED(start));
+   aspacem_assert(VG_IS_PAGE_ALIGNED(len));
+   if (len == 0)
+      return False;
+
+   i = find_nsegment_idx(start);
+   if (nsegments[i].kind != SkAnonC && nsegments[i].kind != SkFileC
+       && nsegments[i].kind != SkShmC)
+      return False;
+   if (!nsegments[i].hasW || start + len - 1 > nsegments[i].end)
+      return False;
+
+   prot = (nsegments[i].hasR ? VKI_PROT_READ : 0)
+          | (nsegments[i].hasX ? VKI_PROT_EXEC : 0)
+          | (write_protect ? 0 : VKI_PROT_WRITE);
+   sres = ML_(am_do_mprotect_NO_NOTIFY)( start, len, prot );
+   if (sr_isError(sres))
+      return False;
+   if (write_protect)
+      client_pages_write_protected = True;
+   return True;
+}
+
+
 /* --- --- --- reservations --- --- --- */
 
 /* Create a reservation from START .. START+LENGTH-1, with the given
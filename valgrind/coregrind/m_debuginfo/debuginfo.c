@@ -56,6 +56,7 @@
 #include "priv_tytypes.h"
 #include "priv_storage.h"
 #include "priv_readdwarf.h"
+#include "priv_dicache.h"
 #if defined(VGO_linux) || defined(VGO_solaris)
 # include "priv_readelf.h"
 # include "priv_readdwarf3.h"
@@ -107,6 +108,15 @@
 
 static UInt debuginfo_generation = 0;
 static void cfsi_m_cache__invalidate ( void );
+static void cfsi_m_cache__invalidate_di ( const DebugInfo* di );
+static Bool di_ix_stale = True;
+
+/* For --stats=yes: the number of objects whose debug info was read,
+   how many of those had part of it deferred (--lazy-debuginfo=yes),
+   and how many of the latter were read in full later on. */
+static UInt n_di_read          = 0;
+static UInt n_di_deferred      = 0;
+static UInt n_di_deferred_read = 0;
 
 
 /*------------------------------------------------------------*/
@@ -163,6 +173,155 @@ static void move_DebugInfo_one_step_forward ( DebugInfo* di )
 }
 
 
+/* Address index.  Two sorted arrays of non-overlapping address ranges,
+   each bound to the DebugInfo it belongs to, so that an address query
+   can go straight to the right DebugInfo instead of walking
+   debugInfo_list.  di_code_ix holds the rx mappings and the text
+   segment of each DebugInfo, di_data_ix its data, sdata, bss, sbss and
+   rodata segments.  Both are rebuilt on first use after di_ix_stale
+   has been set, that is, after DebugInfos have been added, read in,
+   given a new mapping or discarded.  If the ranges of two DebugInfos
+   overlap, that index is not used, and queries walk the list as
+   before. */
+typedef
+   struct { Addr lo; Addr hi; DebugInfo* di; }
+   DiRange;
+
+static XArray* di_code_ix    = NULL; /* of DiRange */
+static XArray* di_data_ix    = NULL; /* of DiRange */
+static Bool    di_code_ix_ok = False;
+static Bool    di_data_ix_ok = False;
+
+static Int cmp_DiRange_by_lo ( const void* v1, const void* v2 )
+{
+   const DiRange* r1 = v1;
+   const DiRange* r2 = v2;
+   if (r1->lo < r2->lo) return -1;
+   if (r1->lo > r2->lo) return 1;
+   return 0;
+}
+
+/* For VG_(lookupXA_UNSAFE): V1 is the key, a one-byte range. */
+static Int cmp_DiRange_overlap ( const void* v1, const void* v2 )
+{
+   const DiRange* r1 = v1;
+   const DiRange* r2 = v2;
+   if (r1->hi < r2->lo) return -1;
+   if (r1->lo > r2->hi) return 1;
+   return 0;
+}
+
+static void add_DiRange ( XArray* ix, Bool present, Addr avma, SizeT size,
+                          DebugInfo* di )
+{
+   DiRange r;
+   if (!present || size == 0)
+      return;
+   r.lo = avma;
+   r.hi = avma + size - 1;
+   r.di = di;
+   VG_(addToXA)(ix, &r);
+}
+
+/* Sort IX and merge the overlapping or adjacent ranges of each
+   DebugInfo.  Returns False if ranges of different DebugInfos
+   overlap. */
+static Bool finish_DiRange_ix ( XArray* ix )
+{
+   Word i, n_out;
+   DiRange *out, *r;
+
+   VG_(sortXA)(ix);
+   n_out = 0;
+   for (i = 0; i < VG_(sizeXA)(ix); i++) {
+      r = VG_(indexXA)(ix, i);
+      if (n_out > 0) {
+         out = VG_(indexXA)(ix, n_out - 1);
+         if (r->lo <= out->hi || r->lo == out->hi + 1) {
+            if (r->di != out->di) {
+               if (r->lo <= out->hi)
+                  return False;
+            } else {
+               if (r->hi > out->hi)
+                  out->hi = r->hi;
+               continue;
+            }
+         }
+      }
+      *(DiRange*)VG_(indexXA)(ix, n_out) = *r;
+      n_out++;
+   }
+   VG_(dropTailXA)(ix, VG_(sizeXA)(ix) - n_out);
+   return True;
+}
+
+static void rebuild_di_ix ( void )
+{
+   DebugInfo* di;
+   Word i;
+
+   if (di_code_ix == NULL) {
+      di_code_ix = VG_(newXA)(ML_(dinfo_zalloc), "di.debuginfo.rdi.1",
+                              ML_(dinfo_free), sizeof(DiRange));
+      di_data_ix = VG_(newXA)(ML_(dinfo_zalloc), "di.debuginfo.rdi.2",
+                              ML_(dinfo_free), sizeof(DiRange));
+      VG_(setCmpFnXA)(di_code_ix, cmp_DiRange_by_lo);
+      VG_(setCmpFnXA)(di_data_ix, cmp_DiRange_by_lo);
+   }
+   VG_(dropTailXA)(di_code_ix, VG_(sizeXA)(di_code_ix));
+   VG_(dropTailXA)(di_data_ix, VG_(sizeXA)(di_data_ix));
+
+   for (di = debugInfo_list; di != NULL; di = di->next) {
+      for (i = 0; i < VG_(sizeXA)(di->fsm.maps); i++) {
+         const DebugInfoMapping* map = VG_(indexXA)(di->fsm.maps, i);
+         add_DiRange(di_code_ix, map->rx, map->avma, map->size, di);
+      }
+      add_DiRange(di_code_ix, di->text_present, di->text_avma,
+                  di->text_size, di);
+      add_DiRange(di_data_ix, di->data_present, di->data_avma,
+                  di->data_size, di);
+      add_DiRange(di_data_ix, di->sdata_present, di->sdata_avma,
+                  di->sdata_size, di);
+      add_DiRange(di_data_ix, di->bss_present, di->bss_avma,
+                  di->bss_size, di);
+      add_DiRange(di_data_ix, di->sbss_present, di->sbss_avma,
+                  di->sbss_size, di);
+      add_DiRange(di_data_ix, di->rodata_present, di->rodata_avma,
+                  di->rodata_size, di);
+   }
+
+   di_code_ix_ok = finish_DiRange_ix(di_code_ix);
+   di_data_ix_ok = finish_DiRange_ix(di_data_ix);
+   di_ix_stale = False;
+}
+
+/* Return the DebugInfo to start searching debugInfo_list at for code
+   (IS_CODE) or data address A.  If the address index could be used,
+   *ONLY is set to True, and the result is the only DebugInfo that can
+   contain A, or NULL if there is none.  Otherwise *ONLY is set to
+   False and the whole list has to be searched. */
+static DebugInfo* first_DebugInfo_for ( Addr a, Bool is_code,
+                                        /*OUT*/Bool* only )
+{
+   DiRange key;
+   Word    first;
+   XArray* ix;
+
+   if (di_ix_stale)
+      rebuild_di_ix();
+   if (is_code ? !di_code_ix_ok : !di_data_ix_ok) {
+      *only = False;
+      return debugInfo_list;
+   }
+   ix = is_code ? di_code_ix : di_data_ix;
+   *only = True;
+   key.lo = key.hi = a;
+   if (!VG_(lookupXA_UNSAFE)(ix, &key, &first, NULL, cmp_DiRange_overlap))
+      return NULL;
+   return ((DiRange*)VG_(indexXA)(ix, first))->di;
+}
+
+
 /*------------------------------------------------------------*/
 /*--- Notification (acquire/discard) helpers               ---*/
 /*------------------------------------------------------------*/
@@ -219,12 +378,21 @@ static void free_DebugInfo ( DebugInfo* di )
    if (di->loctab)       ML_(dinfo_free)(di->loctab);
    if (di->loctab_fndn_ix) ML_(dinfo_free)(di->loctab_fndn_ix);
    if (di->inltab)       ML_(dinfo_free)(di->inltab);
+   if (di->inlfnpool)    VG_(deleteDedupPA)(di->inlfnpool);
    if (di->cfsi_base)    ML_(dinfo_free)(di->cfsi_base);
    if (di->cfsi_m_ix)    ML_(dinfo_free)(di->cfsi_m_ix);
    if (di->cfsi_rd)      ML_(dinfo_free)(di->cfsi_rd);
    if (di->cfsi_m_pool)  VG_(deleteDedupPA)(di->cfsi_m_pool);
    if (di->cfsi_exprs)   VG_(deleteXA)(di->cfsi_exprs);
    if (di->fpo)          ML_(dinfo_free)(di->fpo);
+   if (di->cache_buildid) ML_(dinfo_free)(di->cache_buildid);
+   ML_(free_addr_ix)(&di->symtab_ix);
+   ML_(free_addr_ix)(&di->loctab_ix);
+   ML_(free_addr_ix)(&di->cfsi_ix);
+   ML_(free_addr_ix)(&di->inltab_ix);
+#  if defined(VGO_linux) || defined(VGO_solaris)
+   ML_(discard_deferred_debug_info)(di);
+#  endif
 
    if (di->symtab) {
       /* We have to visit all the entries so as to free up any
@@ -330,7 +498,9 @@ static void discard_DebugInfo ( DebugInfo* di )
          *prev_next_ptr = curr->next;
          if (curr->have_dinfo)
             VG_(redir_notify_delete_DebugInfo)( curr );
+         cfsi_m_cache__invalidate_di(curr);
          free_DebugInfo(curr);
+         di_ix_stale = True;
          return;
       }
       prev_next_ptr = &curr->next;
@@ -714,6 +884,17 @@ static void truncate_DebugInfoMapping_overlaps
    update the FSM and determine when an accept state has been reached.
 */
 
+/* Write DI's tables to the --debuginfo-cache directory, once. */
+static void save_debuginfo_cache ( DebugInfo* di )
+{
+   vg_assert(di->cache_buildid);
+   vg_assert(!di->deferred_dwarf);
+   ML_(save_debuginfo_cache)( di, di->cache_buildid,
+                              di->cache_have_dimg, di->cache_have_aimg );
+   ML_(dinfo_free)(di->cache_buildid);
+   di->cache_buildid = NULL;
+}
+
 /* When the sequence of observations causes a DebugInfoFSM to move
    into the accept state, call here to actually get the debuginfo read
    in.  Returns a ULong whose purpose is described in comments 
@@ -757,8 +938,8 @@ static ULong di_notify_ACHIEVE_ACCEPT_STATE ( struct _DebugInfo* di )
 
       TRACE_SYMTAB("\n------ Canonicalising the "
                    "acquired info ------\n");
-      /* invalidate the CFI unwind cache. */
-      cfsi_m_cache__invalidate();
+      /* invalidate the CFI unwind cache entries for di's range. */
+      cfsi_m_cache__invalidate_di(di);
       /* prepare read data for use */
       ML_(canonicaliseTables)( di );
       /* Check invariants listed in
@@ -766,11 +947,16 @@ static ULong di_notify_ACHIEVE_ACCEPT_STATE ( struct _DebugInfo* di )
          priv_storage.h. */
       check_CFSI_related_invariants(di);
       ML_(finish_CFSI_arrays)(di);
+      if (di->cache_buildid && !di->deferred_dwarf)
+         save_debuginfo_cache(di);
       /* notify m_redir about it */
       TRACE_SYMTAB("\n------ Notifying m_redir ------\n");
       VG_(redir_notify_new_DebugInfo)( di );
       /* Note that we succeeded */
       di->have_dinfo = True;
+      n_di_read++;
+      if (di->deferred_dwarf)
+         n_di_deferred++;
       vg_assert(di->handle > 0);
       di_handle = di->handle;
 
@@ -794,6 +980,38 @@ static ULong di_notify_ACHIEVE_ACCEPT_STATE ( struct _DebugInfo* di )
 }
 
 
+/* With --lazy-debuginfo=yes, read the part of DI's debug info that
+   was deferred when it was loaded.  Called by lookups that need
+   line number, inline or call frame info for an address in DI. */
+static void read_deferred_debug_info ( DebugInfo* di )
+{
+   Bool ok = False;
+
+   vg_assert(di->deferred_dwarf);
+   vg_assert(di->have_dinfo);
+   n_di_deferred_read++;
+   TRACE_SYMTAB("\n------ Reading deferred debug info for %s ------\n",
+                di->fsm.filename);
+#  if defined(VGO_linux) || defined(VGO_solaris)
+   ok = ML_(read_elf_deferred_debug_info)( di );
+#  else
+   vg_assert(0);
+#  endif
+   vg_assert(di->deferred_dwarf == NULL);
+
+   /* Even if reading failed, this finishes off the tables and
+      freezes the pools that were left open for the deferred reader. */
+   cfsi_m_cache__invalidate_di(di);
+   ML_(canonicaliseDeferredTables)( di );
+   check_CFSI_related_invariants(di);
+   ML_(finish_CFSI_arrays)(di);
+
+   /* Don't cache the empty tables left by a failed read. */
+   if (di->cache_buildid && ok)
+      save_debuginfo_cache(di);
+}
+
+
 /* Notify the debuginfo system about a new mapping.  This is the way
    new debug information gets loaded.  If allow_SkFileV is True, it
    will try load debug info if the mapping at 'a' belongs to Valgrind;
@@ -1050,6 +1268,7 @@ ULong VG_(di_notify_mmap)( Addr a, Bool allow_SkFileV, Int use_fd )
    map.rw   = is_rw_map;
    map.ro   = is_ro_map;
    VG_(addToXA)(di->fsm.maps, &map);
+   di_ix_stale = True;
 
    /* Update flags about what kind of mappings we've already seen. */
    di->fsm.have_rx_map |= is_rx_map;
@@ -1078,11 +1297,10 @@ ULong VG_(di_notify_mmap)( Addr a, Bool allow_SkFileV, Int use_fd )
    [a, a+len).  */
 void VG_(di_notify_munmap)( Addr a, SizeT len )
 {
-   Bool anyFound;
    if (0) VG_(printf)("DISCARD %#lx %#lx\n", a, a+len);
-   anyFound = discard_syms_in_range(a, len);
-   if (anyFound)
-      cfsi_m_cache__invalidate();
+   /* discard_DebugInfo drops the CFI cache entries of what it
+      discards. */
+   discard_syms_in_range(a, len);
 }
 
 
@@ -1413,6 +1631,7 @@ void VG_(di_notify_pdb_debuginfo)( Int fd_obj, Addr avma_obj,
      // JRS fixme: take notice of return value from read_pdb_debug_info,
      // and handle failure
      vg_assert(di->have_dinfo); // fails if PDB read failed
+     di_ix_stale = True;
      VG_(am_munmap_valgrind)( (Addr)pdbimage, n_pdbimage );
      VG_(close)(fd_pdbimage);
 
@@ -1518,8 +1737,8 @@ Bool VG_(next_IIPC)(InlIPCursor *iipc)
 
    di = iipc->di;
    for (i = iipc->inltab_lopos; i <= iipc->inltab_hipos; i++) {
-      if (di->inltab[i].addr_lo <= iipc->eip 
-          && iipc->eip < di->inltab[i].addr_hi
+      if (INL_ADDR_LO(di, &di->inltab[i]) <= iipc->eip 
+          && iipc->eip < INL_ADDR_HI(di, &di->inltab[i])
           && di->inltab[i].level < iipc->curlevel
           && (!hinl || hinl->level < di->inltab[i].level)) {
          hinl = &di->inltab[i];
@@ -1548,21 +1767,24 @@ static void search_all_loctabs ( Addr ptr, /*OUT*/DebugInfo** pdi,
    (note that inltab might have duplicates addr_lo). */
 static Word inltab_insert_pos (DebugInfo *di, Addr eip)
 {
-   Word mid, 
-        lo = 0, 
-        hi = di->inltab_used-1;
+   Word mid, lo, hi;
+   Addr mid_lo;
+
+   ML_(addr_ix_range) (&di->inltab_ix, di->inltab_used, eip, &lo, &hi);
    while (lo <= hi) {
       mid      = (lo + hi) / 2;
-      if (eip < di->inltab[mid].addr_lo) { hi = mid-1; continue; } 
-      if (eip > di->inltab[mid].addr_lo) { lo = mid+1; continue; }
+      mid_lo   = INL_ADDR_LO(di, &di->inltab[mid]);
+      if (eip < mid_lo) { hi = mid-1; continue; } 
+      if (eip > mid_lo) { lo = mid+1; continue; }
       lo = mid; break;
    }
 
-   while (lo <= di->inltab_used-1 && di->inltab[lo].addr_lo <= eip)
+   while (lo <= di->inltab_used-1
+          && INL_ADDR_LO(di, &di->inltab[lo]) <= eip)
       lo++;
 #if 0
    for (mid = 0; mid <= di->inltab_used-1; mid++)
-      if (eip < di->inltab[mid].addr_lo)
+      if (eip < INL_ADDR_LO(di, &di->inltab[mid]))
          break;
    vg_assert (lo - 1 == mid - 1);
 #endif
@@ -1590,13 +1812,14 @@ InlIPCursor* VG_(new_IIPC)(Addr eip)
    /* We start from the highest pos in inltab after which eip would
       be inserted. */
    for (i = inltab_insert_pos (di, eip); i >= 0; i--) {
-      if (di->inltab[i].addr_lo <= eip && eip < di->inltab[i].addr_hi) {
+      if (INL_ADDR_LO(di, &di->inltab[i]) <= eip
+          && eip < INL_ADDR_HI(di, &di->inltab[i])) {
          break;
       }
       /* Stop the backward scan when reaching an addr_lo which
          cannot anymore contain eip : we know that all ranges before
          i also cannot contain eip. */
-      if (di->inltab[i].addr_lo < eip - di->maxinl_codesz)
+      if (INL_ADDR_LO(di, &di->inltab[i]) < eip - di->maxinl_codesz)
          return NULL;
    }
    
@@ -1611,7 +1834,7 @@ InlIPCursor* VG_(new_IIPC)(Addr eip)
    ret->inltab_hipos = i;
    for (i = ret->inltab_hipos - 1; i >= 0; i--) {
      
-      if (di->inltab[i].addr_lo < eip - di->maxinl_codesz)
+      if (INL_ADDR_LO(di, &di->inltab[i]) < eip - di->maxinl_codesz)
          break; /* Similar stop backward scan logic as above. */
    }
    ret->inltab_lopos = i + 1;
@@ -1652,9 +1875,10 @@ static void search_all_symtabs ( Addr ptr, /*OUT*/DebugInfo** pdi,
 {
    Word       sno;
    DebugInfo* di;
-   Bool       inRange;
+   Bool       inRange, only;
 
-   for (di = debugInfo_list; di != NULL; di = di->next) {
+   for (di = first_DebugInfo_for(ptr, findText, &only);
+        di != NULL; di = only ? NULL : di->next) {
 
       if (findText) {
          /* Consider any symbol in the r-x mapped area to be text.
@@ -1712,11 +1936,15 @@ static void search_all_loctabs ( Addr ptr, /*OUT*/DebugInfo** pdi,
 {
    Word       lno;
    DebugInfo* di;
-   for (di = debugInfo_list; di != NULL; di = di->next) {
+   Bool       only;
+   for (di = first_DebugInfo_for(ptr, True, &only);
+        di != NULL; di = only ? NULL : di->next) {
       if (di->text_present
           && di->text_size > 0
           && di->text_avma <= ptr 
           && ptr < di->text_avma + di->text_size) {
+         if (UNLIKELY(di->deferred_dwarf != NULL))
+            read_deferred_debug_info( di );
          lno = ML_(search_one_loctab) ( di, ptr );
          if (lno == -1) goto not_found;
          *locno = lno;
@@ -1911,7 +2139,7 @@ Bool VG_(get_fnname_no_cxx_demangle) ( Addr a, const HChar** buf,
          : NULL;
       vg_assert (next_inl);
       // The function we are in is called by next_inl.
-      *buf = next_inl->inlinedfn;
+      *buf = INL_FNNAME(iipc->di, next_inl);
       return True;
    }
 }
@@ -2000,10 +2228,12 @@ Bool VG_(get_objname) ( Addr a, const HChar** buf )
    DebugInfo* di;
    const NSegment *seg;
    const HChar* filename;
+   Bool only;
 
    /* Look in the debugInfo_list to find the name.  In most cases we
       expect this to produce a result. */
-   for (di = debugInfo_list; di != NULL; di = di->next) {
+   for (di = first_DebugInfo_for(a, True, &only);
+        di != NULL; di = only ? NULL : di->next) {
       if (di->text_present
           && di->text_size > 0
           && di->text_avma <= a 
@@ -2031,13 +2261,15 @@ DebugInfo* VG_(find_DebugInfo) ( Addr a )
 {
    static UWord n_search = 0;
    DebugInfo* di;
+   Bool only;
    n_search++;
-   for (di = debugInfo_list; di != NULL; di = di->next) {
+   for (di = first_DebugInfo_for(a, True, &only);
+        di != NULL; di = only ? NULL : di->next) {
       if (di->text_present
           && di->text_size > 0
           && di->text_avma <= a 
           && a < di->text_avma + di->text_size) {
-         if (0 == (n_search & 0xF))
+         if (!only && 0 == (n_search & 0xF))
             move_DebugInfo_one_step_forward( di );
          return di;
       }
@@ -2247,7 +2479,7 @@ const HChar* VG_(describe_IP)(Addr eip, const InlIPCursor *iipc)
          : NULL;
       vg_assert (next_inl);
       // The function we are in is called by next_inl.
-      buf_fn = next_inl->inlinedfn;
+      buf_fn = INL_FNNAME(iipc->di, next_inl);
       know_fnname = True;
 
       // INLINED????
@@ -2549,6 +2781,7 @@ static void find_DiCfSI ( /*OUT*/DebugInfo** diP,
 {
    DebugInfo* di;
    Word       i = -1;
+   Bool       only;
 
    static UWord n_search = 0;
    static UWord n_steps = 0;
@@ -2556,10 +2789,17 @@ static void find_DiCfSI ( /*OUT*/DebugInfo** diP,
 
    if (0) VG_(printf)("search for %#lx\n", ip);
 
-   for (di = debugInfo_list; di != NULL; di = di->next) {
+   for (di = first_DebugInfo_for(ip, True, &only);
+        di != NULL; di = only ? NULL : di->next) {
       Word j;
       n_steps++;
 
+      /* The call frame info may not have been read yet.  It can
+         cover any rx mapping, not just the text segment. */
+      if (UNLIKELY(di->deferred_dwarf != NULL)
+          && ML_(find_rx_mapping)( di, ip, ip ) != NULL)
+         read_deferred_debug_info( di );
+
       /* Use the per-DebugInfo summary address ranges to skip
          inapplicable DebugInfos quickly. */
       if (di->cfsi_used == 0)
@@ -2605,7 +2845,7 @@ static void find_DiCfSI ( /*OUT*/DebugInfo** diP,
          amd64, this in fact reduces the total amount of searching
          done by the above find-the-right-DebugInfo loop by more than
          a factor of 20. */
-      if ((n_search & 0xF) == 0) {
+      if (!only && (n_search & 0xF) == 0) {
          /* Move di one step closer to the start of the list. */
          move_DebugInfo_one_step_forward( di );
       }
@@ -2637,22 +2877,108 @@ static void find_DiCfSI ( /*OUT*/DebugInfo** diP,
    We can map an ip value directly to a (di, cfsi_m*) pair as
    once a DebugInfo is read, adding new DiCfSI_m* is not possible
    anymore, as the cfsi_m_pool is frozen once the reading is terminated.
-   Also, the cache is invalidated when new debuginfo is read due to
-   an mmap or some debuginfo is discarded due to an munmap. */
-
-// Prime number, giving about 6Kbytes cache on 32 bits,
-//                           12Kbytes cache on 64 bits.
-#define N_CFSI_M_CACHE 509
+   The entries for a DebugInfo's range are invalidated when its debug
+   info is read, in full or in part, and when it is discarded; the
+   rest of the cache is left alone.
+
+   The cache is CFSI_M_CACHE_WAYS-way set-associative, with the most
+   recently used entry of a set first.  It starts with
+   CFSI_M_CACHE_MIN_SETS sets and doubles in size, up to
+   CFSI_M_CACHE_MAX_SETS, whenever more than 1/16 of the queries in a
+   window of CFSI_M_CACHE_WINDOW queries miss: deep stack traces of
+   big programs have a working set far beyond what suits small ones. */
+
+#define CFSI_M_CACHE_WAYS     4
+#define CFSI_M_CACHE_MIN_SETS 128     /* power of 2 */
+#define CFSI_M_CACHE_MAX_SETS 16384   /* power of 2 */
+#define CFSI_M_CACHE_WINDOW   65536
 
 typedef
    struct { Addr ip; DebugInfo* di; DiCfSI_m* cfsi_m; }
    CFSI_m_CacheEnt;
 
-static CFSI_m_CacheEnt cfsi_m_cache[N_CFSI_M_CACHE];
+static CFSI_m_CacheEnt* cfsi_m_cache = NULL;
+static UWord cfsi_m_cache_n_sets = 0;
+
+/* For --stats=yes, and for sizing the cache. */
+static ULong cfsi_m_cache_n_q = 0;
+static ULong cfsi_m_cache_n_m = 0;
+static UInt  cfsi_m_cache_n_resizes = 0;
+static UInt  cfsi_m_cache_win_q = 0;
+static UInt  cfsi_m_cache_win_m = 0;
+
+static inline CFSI_m_CacheEnt* cfsi_m_cache__set ( Addr ip )
+{
+   UWord hash = (ip ^ (ip >> 11)) & (cfsi_m_cache_n_sets - 1);
+   return &cfsi_m_cache[hash * CFSI_M_CACHE_WAYS];
+}
+
+/* Make ENT the most recently used entry of SET, dropping the least
+   recently used one. */
+static inline void cfsi_m_cache__insert ( CFSI_m_CacheEnt* set,
+                                          const CFSI_m_CacheEnt* ent )
+{
+   Int w;
+   for (w = CFSI_M_CACHE_WAYS - 1; w > 0; w--)
+      set[w] = set[w-1];
+   set[0] = *ent;
+}
+
+/* (Re)allocate the cache with N_SETS sets, keeping what is in it. */
+static void cfsi_m_cache__resize ( UWord n_sets )
+{
+   CFSI_m_CacheEnt* old       = cfsi_m_cache;
+   UWord            old_n_ent = cfsi_m_cache_n_sets * CFSI_M_CACHE_WAYS;
+   Word             i;
+
+   cfsi_m_cache = ML_(dinfo_zalloc)("di.debuginfo.cmcr.1",
+                                    n_sets * CFSI_M_CACHE_WAYS
+                                    * sizeof(CFSI_m_CacheEnt));
+   cfsi_m_cache_n_sets = n_sets;
+   if (old == NULL)
+      return;
+   /* Oldest first, so that each set keeps its order. */
+   for (i = old_n_ent - 1; i >= 0; i--) {
+      if (old[i].di != NULL)
+         cfsi_m_cache__insert(cfsi_m_cache__set(old[i].ip), &old[i]);
+   }
+   ML_(dinfo_free)(old);
+   cfsi_m_cache_n_resizes++;
+}
 
 static void cfsi_m_cache__invalidate ( void ) {
-   VG_(memset)(&cfsi_m_cache, 0, sizeof(cfsi_m_cache));
+   if (cfsi_m_cache)
+      VG_(memset)(cfsi_m_cache, 0, cfsi_m_cache_n_sets * CFSI_M_CACHE_WAYS
+                                   * sizeof(CFSI_m_CacheEnt));
+   debuginfo_generation++;
+   di_ix_stale = True;
+}
+
+/* Invalidate the entries that may change now that the CFI of DI has
+   been read or is about to be discarded: those that point to DI, and
+   those for an address in one of its rx mappings. */
+static void cfsi_m_cache__invalidate_di ( const DebugInfo* di ) {
+   UWord i, n_ent = cfsi_m_cache_n_sets * CFSI_M_CACHE_WAYS;
+   Word  j;
+   for (i = 0; i < n_ent; i++) {
+      CFSI_m_CacheEnt* ce = &cfsi_m_cache[i];
+      if (ce->di == NULL)
+         continue;
+      if (ce->di == di) {
+         ce->di = NULL;
+         continue;
+      }
+      for (j = 0; j < VG_(sizeXA)(di->fsm.maps); j++) {
+         const DebugInfoMapping* map = VG_(indexXA)(di->fsm.maps, j);
+         if (map->rx && ce->ip >= map->avma
+             && ce->ip - map->avma < map->size) {
+            ce->di = NULL;
+            break;
+         }
+      }
+   }
    debuginfo_generation++;
+   di_ix_stale = True;
 }
 
 UInt VG_(debuginfo_generation) (void)
@@ -2662,29 +2988,53 @@ UInt VG_(debuginfo_generation) (void)
 
 static inline CFSI_m_CacheEnt* cfsi_m_cache__find ( Addr ip )
 {
-   UWord         hash = ip % N_CFSI_M_CACHE;
-   CFSI_m_CacheEnt* ce = &cfsi_m_cache[hash];
-   static UWord  n_q = 0, n_m = 0;
+   CFSI_m_CacheEnt* set;
+   CFSI_m_CacheEnt  ent;
+   Int              w;
+
+   if (UNLIKELY(++cfsi_m_cache_win_q == CFSI_M_CACHE_WINDOW)) {
+      if (cfsi_m_cache_win_m > CFSI_M_CACHE_WINDOW / 16
+          && cfsi_m_cache_n_sets < CFSI_M_CACHE_MAX_SETS)
+         cfsi_m_cache__resize(2 * cfsi_m_cache_n_sets);
+      cfsi_m_cache_win_q = 0;
+      cfsi_m_cache_win_m = 0;
+   }
+   if (UNLIKELY(cfsi_m_cache == NULL))
+      cfsi_m_cache__resize(CFSI_M_CACHE_MIN_SETS);
 
-   n_q++;
-   if (0 && 0 == (n_q & 0x1FFFFF))
-      VG_(printf)("QQQ %lu %lu\n", n_q, n_m);
+   cfsi_m_cache_n_q++;
+   set = cfsi_m_cache__set(ip);
 
-   if (LIKELY(ce->ip == ip) && LIKELY(ce->di != NULL)) {
+   if (LIKELY(set[0].ip == ip) && LIKELY(set[0].di != NULL)) {
       /* found an entry in the cache .. */
    } else {
-      /* not found in cache.  Search and update. */
-      n_m++;
-      ce->ip = ip;
-      find_DiCfSI( &ce->di, &ce->cfsi_m, ip );
+      for (w = 1; w < CFSI_M_CACHE_WAYS; w++)
+         if (set[w].ip == ip && set[w].di != NULL)
+            break;
+      if (w < CFSI_M_CACHE_WAYS) {
+         /* .. further down the set; move it to the front. */
+         ent = set[w];
+         for (; w > 0; w--)
+            set[w] = set[w-1];
+         set[0] = ent;
+      } else {
+         /* not found in cache.  Search and update.  find_DiCfSI may
+            read deferred debug info, which invalidates part of the
+            cache, so only insert the result afterwards. */
+         cfsi_m_cache_n_m++;
+         cfsi_m_cache_win_m++;
+         find_DiCfSI( &ent.di, &ent.cfsi_m, ip );
+         ent.ip = ip;
+         cfsi_m_cache__insert(set, &ent);
+      }
    }
 
-   if (UNLIKELY(ce->di == (DebugInfo*)1)) {
+   if (UNLIKELY(set[0].di == (DebugInfo*)1)) {
       /* no DiCfSI for this address */
       return NULL;
    } else {
       /* found a DiCfSI for this address */
-      return ce;
+      return &set[0];
    }
 }
 
@@ -2841,13 +3191,17 @@ void VG_(ppUnwindInfo) (Addr from, Addr to)
    CFSI_m_CacheEnt*   ce;
    Addr ce_from;
    CFSI_m_CacheEnt*   next_ce;
-
+   /* A lookup can move the entries of the cache around, so work on
+      copies of them. */
+   CFSI_m_CacheEnt    ce_copy, next_ce_copy;
 
    ce = cfsi_m_cache__find(from);
+   if (ce) { ce_copy = *ce; ce = &ce_copy; }
    ce_from = from;
    while (from <= to) {
       from++;
       next_ce = cfsi_m_cache__find(from);
+      if (next_ce) { next_ce_copy = *next_ce; next_ce = &next_ce_copy; }
       if ((ce == NULL && next_ce != NULL)
           || (ce != NULL && next_ce == NULL)
           || (ce != NULL && next_ce != NULL && ce->cfsi_m != next_ce->cfsi_m)
@@ -2860,7 +3214,8 @@ void VG_(ppUnwindInfo) (Addr from, Addr to)
                           ce_from, from - ce_from,
                           ce->cfsi_m);
          }
-         ce = next_ce;
+         if (next_ce) ce_copy = next_ce_copy;
+         ce = next_ce ? &ce_copy : NULL;
          ce_from = from;
       }
    }
@@ -4433,6 +4788,25 @@ VgSectKind VG_(DebugInfo_sect_kind)( /*OUT*/const HChar** name, Addr a)
 
 }
 
+void VG_(print_debuginfo_stats)( void )
+{
+   /* Miss rate, in tenths of a percent. */
+   ULong miss_pm = cfsi_m_cache_n_q == 0
+                   ? 0 : cfsi_m_cache_n_m * 1000 / cfsi_m_cache_n_q;
+
+   VG_(message)(Vg_DebugMsg,
+                "debuginfo: %'u objects read, %'u deferred, "
+                "%'u of those read on demand\n",
+                n_di_read, n_di_deferred, n_di_deferred_read);
+   VG_(message)(Vg_DebugMsg,
+                "cfsi cache: %'llu queries, %'llu misses (%llu.%llu%%), "
+                "%'lu entries after %u resizes\n",
+                cfsi_m_cache_n_q, cfsi_m_cache_n_m,
+                miss_pm / 10, miss_pm % 10,
+                cfsi_m_cache_n_sets * CFSI_M_CACHE_WAYS,
+                cfsi_m_cache_n_resizes);
+}
+
 /*--------------------------------------------------------------------*/
 /*--- end                                                          ---*/
 /*--------------------------------------------------------------------*/
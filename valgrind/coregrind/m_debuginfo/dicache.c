@@ -0,0 +1,736 @@
+/* -*- mode: C; c-basic-offset: 3; -*- */
+
+/*--------------------------------------------------------------------*/
+/*--- On-disk cache of line number, inline and CFI tables.         ---*/
+/*---                                                    dicache.c ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   Copyright (C) 2015-2015 The Valgrind developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+/* With --debuginfo-cache=<dir>, the line number, inline and call
+   frame tables of each object that has a build-id are written to
+   <dir>/<build-id>.vgdi after they have been read from the DWARF and
+   canonicalised.  When an object with the same build-id is loaded in
+   a later run, the tables are replayed from that file through the
+   usual ML_(addLineInfo), ML_(addInlInfo) and ML_(addDiCfSI) calls,
+   and no DWARF is parsed at all.  The symbol table is not cached: it
+   is cheap to read and m_redir needs it as soon as the object is
+   mapped.
+
+   A file is only used if it was written by the same Valgrind version
+   for the same platform, with the same --read-inline-info setting and
+   the same set of debug files (main, separate debug, alt debug), and
+   if the object is mapped with the same layout relative to its text
+   segment.  Addresses are stored relative to the start of the text
+   segment so that the file can be reused whatever address the object
+   is loaded at.  Everything is stored in host byte order.
+
+   File layout, each part following the previous one directly:
+
+      VgDiCacheHdr
+      n_maps  x VgDiCacheMap
+      n_strs  bytes of NUL-terminated strings
+      n_fndn  x VgDiCacheFnDn    (fndn_ix 1 .. n_fndn)
+      n_loc   x VgDiCacheLoc
+      n_inl   x VgDiCacheInl
+      n_cfsi_m x DiCfSI_m        (cfsi_m_ix 1 .. n_cfsi_m), padded
+                                 to a multiple of 8 bytes
+      n_cfsi  x VgDiCacheCfSI
+      n_exprs x CfiExpr
+*/
+
+#include "config.h"                // VERSION
+#include "pub_core_basics.h"
+#include "pub_core_vki.h"
+#include "pub_core_libcbase.h"
+#include "pub_core_libcassert.h"
+#include "pub_core_libcfile.h"
+#include "pub_core_libcprint.h"
+#include "pub_core_libcproc.h"     // VG_(getpid)
+#include "pub_core_options.h"
+#include "pub_core_xarray.h"
+#include "pub_core_hashtable.h"
+#include "priv_misc.h"             // dinfo_zalloc/free/strdup
+#include "priv_storage.h"
+#include "priv_dicache.h"          // self
+
+#define VGDI_MAGIC "VGDICACH"
+
+/* Flags recorded in the header; a file is only used if they match. */
+#define VGDI_INLINE_INFO 0x1  /* --read-inline-info=yes */
+#define VGDI_DEBUG_IMG   0x2  /* a separate debug file was found */
+#define VGDI_ALT_IMG     0x4  /* an alt debug file was found */
+
+typedef
+   struct {
+      HChar magic[8];
+      HChar version[40];      /* VERSION "-" VG_PLATFORM */
+      UInt  sizeof_cfsi_m;
+      UInt  sizeof_cfi_expr;
+      UInt  flags;
+      UInt  n_maps;
+      UInt  n_strs;
+      UInt  n_fndn;
+      UInt  n_loc;
+      UInt  n_inl;
+      UInt  n_cfsi_m;
+      UInt  n_cfsi;
+      UInt  n_exprs;
+      UInt  pad;
+   }
+   VgDiCacheHdr;
+
+typedef
+   struct {
+      ULong rel_avma;
+      ULong size;
+      ULong foff;
+      UInt  prot;             /* 1: rx, 2: rw, 4: ro */
+      UInt  pad;
+   }
+   VgDiCacheMap;
+
+typedef
+   struct {
+      UInt filename;          /* offset in the strings */
+      UInt dirname;           /* ditto, or NO_STR */
+   }
+   VgDiCacheFnDn;
+
+#define NO_STR 0xFFFFFFFF
+
+/* Size of the DiCfSI_m part of a file, which is padded so that the
+   records following it are aligned. */
+#define CFSI_M_SZB(_n) VG_ROUNDUP((ULong)(_n) * sizeof(DiCfSI_m), 8)
+
+typedef
+   struct {
+      ULong rel_addr;
+      UInt  size;
+      UInt  lineno;
+      UInt  fndn_ix;
+      UInt  pad;
+   }
+   VgDiCacheLoc;
+
+typedef
+   struct {
+      ULong rel_addr_lo;
+      ULong rel_addr_hi;
+      UInt  inlinedfn;        /* offset in the strings */
+      UInt  fndn_ix;
+      UInt  lineno;
+      UInt  level;
+   }
+   VgDiCacheInl;
+
+typedef
+   struct {
+      ULong rel_base;
+      UInt  len;
+      UInt  cfsi_m_ix;
+   }
+   VgDiCacheCfSI;
+
+
+/*------------------------------------------------------------*/
+/*--- Helpers                                              ---*/
+/*------------------------------------------------------------*/
+
+static HChar* cache_file_name ( const HChar* buildid )
+{
+   const HChar* dir = VG_(clo_debuginfo_cache);
+   HChar* name = ML_(dinfo_zalloc)("di.dicache.cfn.1",
+                                   VG_(strlen)(dir) + 1
+                                   + VG_(strlen)(buildid) + 6);
+   VG_(sprintf)(name, "%s/%s.vgdi", dir, buildid);
+   return name;
+}
+
+static UInt cache_flags ( Bool have_dimg, Bool have_aimg )
+{
+   return (VG_(clo_read_inline_info) ? VGDI_INLINE_INFO : 0)
+          | (have_dimg ? VGDI_DEBUG_IMG : 0)
+          | (have_aimg ? VGDI_ALT_IMG : 0);
+}
+
+static void init_header ( VgDiCacheHdr* hdr, UInt flags )
+{
+   VG_(memset)(hdr, 0, sizeof(*hdr));
+   VG_(memcpy)(hdr->magic, VGDI_MAGIC, sizeof(hdr->magic));
+   VG_(snprintf)(hdr->version, sizeof(hdr->version),
+                 "%s-%s", VERSION, VG_PLATFORM);
+   hdr->sizeof_cfsi_m   = sizeof(DiCfSI_m);
+   hdr->sizeof_cfi_expr = sizeof(CfiExpr);
+   hdr->flags           = flags;
+}
+
+static UInt map_prot ( const DebugInfoMapping* map )
+{
+   return (map->rx ? 1 : 0) | (map->rw ? 2 : 0) | (map->ro ? 4 : 0);
+}
+
+/* Only objects with a text segment can be cached, since addresses are
+   stored relative to it. */
+static Bool cacheable ( const DebugInfo* di )
+{
+   return di->text_present && di->fsm.maps != NULL;
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Loading                                              ---*/
+/*------------------------------------------------------------*/
+
+/* Reads the whole of file FD into a new buffer, or returns NULL. */
+static UChar* read_whole_file ( Int fd, /*OUT*/SizeT* szB )
+{
+   Long   fsize = VG_(fsize)(fd);
+   UChar* buf;
+   SizeT  done = 0;
+
+   if (fsize < (Long)sizeof(VgDiCacheHdr) || fsize > 0x7FFFFFFFL)
+      return NULL;
+   buf = ML_(dinfo_zalloc)("di.dicache.rwf.1", fsize);
+   while (done < fsize) {
+      Int n = VG_(read)(fd, buf + done, fsize - done);
+      if (n <= 0) {
+         ML_(dinfo_free)(buf);
+         return NULL;
+      }
+      done += n;
+   }
+   *szB = fsize;
+   return buf;
+}
+
+/* The unwinder asserts on any 'how' value or expression it does not
+   know about, so everything in a cache file that it will later look
+   at is checked here first.  These mirror the cases handled by
+   compute_cfa, VG_(use_CF_info) and evalCfiExpr in debuginfo.c. */
+
+static Bool cfir_ok ( UChar how, Int off, UInt n_exprs )
+{
+   switch (how) {
+      case CFIR_UNKNOWN: case CFIR_SAME:
+      case CFIR_CFAREL:  case CFIR_MEMCFAREL:
+         return True;
+      case CFIR_EXPR:
+         return off >= 0 && (UInt)off < n_exprs;
+      default:
+         return False;
+   }
+}
+
+static Bool cfic_ok ( UChar how, Int off, UInt n_exprs )
+{
+   switch (how) {
+#     if defined(VGA_x86) || defined(VGA_amd64)
+      case CFIC_IA_SPREL: case CFIC_IA_BPREL:
+#     elif defined(VGA_arm)
+      case CFIC_ARM_R13REL: case CFIC_ARM_R12REL:
+      case CFIC_ARM_R11REL: case CFIC_ARM_R7REL:
+#     elif defined(VGA_s390x)
+      case CFIC_IA_SPREL: case CFIC_IA_BPREL:
+      case CFIR_SAME: case CFIR_MEMCFAREL:
+#     elif defined(VGA_mips32) || defined(VGA_mips64) || defined(VGA_tilegx)
+      case CFIC_IA_SPREL: case CFIC_IA_BPREL:
+      case CFIR_SAME:
+#     elif defined(VGA_arm64)
+      case CFIC_ARM64_SPREL: case CFIC_ARM64_X29REL:
+#     endif
+         return True;
+      case CFIC_EXPR:
+         return off >= 0 && (UInt)off < n_exprs;
+      default:
+         return False;
+   }
+}
+
+static Bool cfsi_m_ok ( const DiCfSI_m* m, UInt n_exprs )
+{
+   if (!cfic_ok(m->cfa_how, m->cfa_off, n_exprs)
+       || !cfir_ok(m->ra_how, m->ra_off, n_exprs))
+      return False;
+#  if defined(VGA_x86) || defined(VGA_amd64)
+   return cfir_ok(m->sp_how, m->sp_off, n_exprs)
+          && cfir_ok(m->bp_how, m->bp_off, n_exprs);
+#  elif defined(VGA_arm)
+   return cfir_ok(m->r14_how, m->r14_off, n_exprs)
+          && cfir_ok(m->r13_how, m->r13_off, n_exprs)
+          && cfir_ok(m->r12_how, m->r12_off, n_exprs)
+          && cfir_ok(m->r11_how, m->r11_off, n_exprs)
+          && cfir_ok(m->r7_how,  m->r7_off,  n_exprs);
+#  elif defined(VGA_arm64)
+   return cfir_ok(m->sp_how,  m->sp_off,  n_exprs)
+          && cfir_ok(m->x30_how, m->x30_off, n_exprs)
+          && cfir_ok(m->x29_how, m->x29_off, n_exprs);
+#  elif defined(VGA_ppc32) || defined(VGA_ppc64be) || defined(VGA_ppc64le)
+   return True;
+#  else /* s390x, mips32/64, tilegx */
+   return cfir_ok(m->sp_how, m->sp_off, n_exprs)
+          && cfir_ok(m->fp_how, m->fp_off, n_exprs);
+#  endif
+}
+
+static Bool cfi_reg_ok ( CfiReg reg )
+{
+   switch (reg) {
+#     if defined(VGA_x86) || defined(VGA_amd64)
+      case Creg_IA_IP: case Creg_IA_SP: case Creg_IA_BP:
+#     elif defined(VGA_arm)
+      case Creg_ARM_R15: case Creg_ARM_R14: case Creg_ARM_R13:
+      case Creg_ARM_R12: case Creg_ARM_R7:
+#     elif defined(VGA_s390x)
+      case Creg_S390_IA: case Creg_S390_SP:
+      case Creg_S390_FP: case Creg_S390_LR:
+#     elif defined(VGA_mips32) || defined(VGA_mips64)
+      case Creg_IA_IP: case Creg_IA_SP: case Creg_IA_BP: case Creg_MIPS_RA:
+#     elif defined(VGA_arm64)
+      case Creg_ARM64_X30:
+#     elif defined(VGA_tilegx)
+      case Creg_TILEGX_IP: case Creg_TILEGX_SP:
+      case Creg_TILEGX_BP: case Creg_TILEGX_LR:
+#     endif
+         return True;
+      default:
+         return False;
+   }
+}
+
+/* The reader builds each expression tree children first, so a node
+   may only refer to nodes before it.  Checking that also rules out
+   cycles, which evalCfiExpr would otherwise recurse around forever. */
+static Bool cfi_expr_ok ( const CfiExpr* e, Int ix )
+{
+   switch (e->tag) {
+      case Cex_Undef:
+      case Cex_Const:
+         return True;
+      case Cex_Deref:
+         return e->Cex.Deref.ixAddr >= 0 && e->Cex.Deref.ixAddr < ix;
+      case Cex_Unop:
+         return e->Cex.Unop.op >= Cunop_Abs && e->Cex.Unop.op <= Cunop_Not
+                && e->Cex.Unop.ix >= 0 && e->Cex.Unop.ix < ix;
+      case Cex_Binop:
+         return e->Cex.Binop.op >= Cbinop_Add && e->Cex.Binop.op <= Cbinop_Ne
+                && e->Cex.Binop.ixL >= 0 && e->Cex.Binop.ixL < ix
+                && e->Cex.Binop.ixR >= 0 && e->Cex.Binop.ixR < ix;
+      case Cex_CfiReg:
+         return cfi_reg_ok(e->Cex.CfiReg.reg);
+      default:
+         /* Cex_DwReg never survives into di->cfsi_exprs. */
+         return False;
+   }
+}
+
+Bool ML_(load_debuginfo_cache) ( DebugInfo* di, const HChar* buildid,
+                                 Bool have_dimg, Bool have_aimg )
+{
+   HChar*        name;
+   SysRes        fd;
+   UChar*        buf;
+   SizeT         szB = 0, need;
+   VgDiCacheHdr  want;
+   const VgDiCacheHdr*  hdr;
+   const VgDiCacheMap*  maps;
+   const HChar*         strs;
+   const VgDiCacheFnDn* fndns;
+   const VgDiCacheLoc*  locs;
+   const VgDiCacheInl*  inls;
+   const DiCfSI_m*      cfsi_ms;
+   const VgDiCacheCfSI* cfsis;
+   const CfiExpr*       exprs;
+   UInt*         fndn_remap;
+   UInt          i, n_maps;
+   Bool          ok = False;
+
+   vg_assert(VG_(clo_debuginfo_cache));
+   if (!cacheable(di))
+      return False;
+
+   name = cache_file_name(buildid);
+   fd = VG_(open)(name, VKI_O_RDONLY, 0);
+   if (sr_isError(fd)) {
+      ML_(dinfo_free)(name);
+      return False;
+   }
+   buf = read_whole_file(sr_Res(fd), &szB);
+   VG_(close)(sr_Res(fd));
+   if (buf == NULL)
+      goto out;
+
+   /* Check the header, and that the sizes it gives add up. */
+   hdr = (const VgDiCacheHdr*)buf;
+   init_header(&want, cache_flags(have_dimg, have_aimg));
+   if (VG_(memcmp)(hdr->magic, want.magic, sizeof(want.magic)) != 0
+       || VG_(strcmp)(hdr->version, want.version) != 0
+       || hdr->sizeof_cfsi_m   != want.sizeof_cfsi_m
+       || hdr->sizeof_cfi_expr != want.sizeof_cfi_expr
+       || hdr->flags           != want.flags)
+      goto out;
+   need = sizeof(VgDiCacheHdr)
+          + (ULong)hdr->n_maps   * sizeof(VgDiCacheMap)
+          + (ULong)hdr->n_strs
+          + (ULong)hdr->n_fndn   * sizeof(VgDiCacheFnDn)
+          + (ULong)hdr->n_loc    * sizeof(VgDiCacheLoc)
+          + (ULong)hdr->n_inl    * sizeof(VgDiCacheInl)
+          + CFSI_M_SZB(hdr->n_cfsi_m)
+          + (ULong)hdr->n_cfsi   * sizeof(VgDiCacheCfSI)
+          + (ULong)hdr->n_exprs  * sizeof(CfiExpr);
+   if (need != szB)
+      goto out;
+
+   /* The parts are all multiples of 8 bytes in size, apart from the
+      strings, which are padded to 8 bytes by the writer. */
+   maps    = (const VgDiCacheMap*)(hdr + 1);
+   strs    = (const HChar*)(maps + hdr->n_maps);
+   fndns   = (const VgDiCacheFnDn*)(strs + hdr->n_strs);
+   locs    = (const VgDiCacheLoc*)(fndns + hdr->n_fndn);
+   inls    = (const VgDiCacheInl*)(locs + hdr->n_loc);
+   cfsi_ms = (const DiCfSI_m*)(inls + hdr->n_inl);
+   cfsis   = (const VgDiCacheCfSI*)((const UChar*)cfsi_ms
+                                    + CFSI_M_SZB(hdr->n_cfsi_m));
+   exprs   = (const CfiExpr*)(cfsis + hdr->n_cfsi);
+   if (hdr->n_strs % 8 != 0
+       || (hdr->n_strs > 0 && strs[hdr->n_strs - 1] != 0))
+      goto out;
+
+   /* The object must be mapped the same way, relative to its text
+      segment, as when the file was written. */
+   n_maps = VG_(sizeXA)(di->fsm.maps);
+   if (hdr->n_maps != n_maps)
+      goto out;
+   for (i = 0; i < n_maps; i++) {
+      const DebugInfoMapping* map = VG_(indexXA)(di->fsm.maps, i);
+      if (maps[i].rel_avma != (ULong)(map->avma - di->text_avma)
+          || maps[i].size  != map->size
+          || maps[i].foff  != (ULong)map->foff
+          || maps[i].prot  != map_prot(map))
+         goto out;
+   }
+
+   /* Check all string and index references before adding anything,
+      so that a damaged file cannot leave DI half filled in. */
+   for (i = 0; i < hdr->n_fndn; i++)
+      if (fndns[i].filename >= hdr->n_strs
+          || (fndns[i].dirname != NO_STR && fndns[i].dirname >= hdr->n_strs))
+         goto out;
+   for (i = 0; i < hdr->n_loc; i++)
+      if (locs[i].fndn_ix > hdr->n_fndn)
+         goto out;
+   for (i = 0; i < hdr->n_inl; i++)
+      if (inls[i].inlinedfn >= hdr->n_strs || inls[i].fndn_ix > hdr->n_fndn)
+         goto out;
+   for (i = 0; i < hdr->n_cfsi; i++)
+      if (cfsis[i].cfsi_m_ix == 0 || cfsis[i].cfsi_m_ix > hdr->n_cfsi_m
+          || cfsis[i].len == 0)
+         goto out;
+   for (i = 0; i < hdr->n_cfsi_m; i++)
+      if (!cfsi_m_ok(&cfsi_ms[i], hdr->n_exprs))
+         goto out;
+   for (i = 0; i < hdr->n_exprs; i++)
+      if (!cfi_expr_ok(&exprs[i], i))
+         goto out;
+
+   /* Replay the tables. */
+   fndn_remap = ML_(dinfo_zalloc)("di.dicache.ldc.1",
+                                  (hdr->n_fndn + 1) * sizeof(UInt));
+   for (i = 0; i < hdr->n_fndn; i++)
+      fndn_remap[i+1]
+         = ML_(addFnDn)(di, strs + fndns[i].filename,
+                        fndns[i].dirname == NO_STR
+                           ? NULL : strs + fndns[i].dirname);
+   for (i = 0; i < hdr->n_loc; i++) {
+      Addr a = di->text_avma + (Addr)locs[i].rel_addr;
+      ML_(addLineInfo)(di, fndn_remap[locs[i].fndn_ix],
+                       a, a + locs[i].size, locs[i].lineno, i);
+   }
+   for (i = 0; i < hdr->n_inl; i++)
+      ML_(addInlInfo)(di, di->text_avma + (Addr)inls[i].rel_addr_lo,
+                          di->text_avma + (Addr)inls[i].rel_addr_hi,
+                          ML_(addStr)(di, strs + inls[i].inlinedfn, -1),
+                          fndn_remap[inls[i].fndn_ix],
+                          inls[i].lineno, inls[i].level);
+   ML_(dinfo_free)(fndn_remap);
+
+   if (hdr->n_exprs > 0) {
+      vg_assert(di->cfsi_exprs == NULL);
+      di->cfsi_exprs = VG_(newXA)( ML_(dinfo_zalloc), "di.dicache.ldc.2",
+                                   ML_(dinfo_free), sizeof(CfiExpr) );
+      for (i = 0; i < hdr->n_exprs; i++)
+         VG_(addToXA)(di->cfsi_exprs, &exprs[i]);
+   }
+   for (i = 0; i < hdr->n_cfsi; i++) {
+      DiCfSI_m cfsi_m = cfsi_ms[cfsis[i].cfsi_m_ix - 1];
+      ML_(addDiCfSI)(di, di->text_avma + (Addr)cfsis[i].rel_base,
+                     cfsis[i].len, &cfsi_m);
+   }
+   ok = True;
+
+   if (VG_(clo_verbosity) > 1)
+      VG_(message)(Vg_DebugMsg, "debuginfo cache: loaded %s for %s\n",
+                   name, di->fsm.filename);
+
+  out:
+   if (buf)
+      ML_(dinfo_free)(buf);
+   ML_(dinfo_free)(name);
+   return ok;
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Saving                                               ---*/
+/*------------------------------------------------------------*/
+
+/* A simple buffered writer, since the tables are written one small
+   record at a time. */
+typedef
+   struct {
+      Int   fd;
+      Bool  failed;
+      UInt  used;
+      UChar buf[65536];
+   }
+   Writer;
+
+static void w_flush ( Writer* w )
+{
+   UInt done = 0;
+   while (!w->failed && done < w->used) {
+      Int n = VG_(write)(w->fd, w->buf + done, w->used - done);
+      if (n <= 0)
+         w->failed = True;
+      else
+         done += n;
+   }
+   w->used = 0;
+}
+
+static void w_put ( Writer* w, const void* p, UInt szB )
+{
+   const UChar* src = p;
+   while (szB > 0) {
+      UInt n = sizeof(w->buf) - w->used;
+      if (n > szB)
+         n = szB;
+      VG_(memcpy)(w->buf + w->used, src, n);
+      w->used += n;
+      src += n;
+      szB -= n;
+      if (w->used == sizeof(w->buf))
+         w_flush(w);
+   }
+}
+
+/* Strings written so far, keyed by their address.  The strings of a
+   DebugInfo are all in its strpool, so equal strings have equal
+   addresses. */
+typedef
+   struct _StrNode {
+      struct _StrNode* next;
+      UWord key;
+      UInt  off;
+   }
+   StrNode;
+
+static UInt str_off ( VgHashTable* ht, XArray* strs, const HChar* str )
+{
+   StrNode* node = VG_(HT_lookup)(ht, (UWord)str);
+   if (node == NULL) {
+      node = ML_(dinfo_zalloc)("di.dicache.so.1", sizeof(StrNode));
+      node->key = (UWord)str;
+      node->off = VG_(sizeXA)(strs);
+      VG_(addBytesToXA)(strs, str, VG_(strlen)(str) + 1);
+      VG_(HT_add_node)(ht, node);
+   }
+   return node->off;
+}
+
+static UInt get_cfsi_m_ix ( const DebugInfo* di, UWord pos )
+{
+   UInt cfsi_m_ix;
+   switch (di->sizeof_cfsi_m_ix) {
+      case 1: cfsi_m_ix = ((UChar*)  di->cfsi_m_ix)[pos]; break;
+      case 2: cfsi_m_ix = ((UShort*) di->cfsi_m_ix)[pos]; break;
+      case 4: cfsi_m_ix = ((UInt*)   di->cfsi_m_ix)[pos]; break;
+      default: vg_assert(0);
+   }
+   return cfsi_m_ix;
+}
+
+void ML_(save_debuginfo_cache) ( DebugInfo* di, const HChar* buildid,
+                                 Bool have_dimg, Bool have_aimg )
+{
+   VgHashTable*  str_ht;
+   XArray*       strs;       /* of HChar */
+   XArray*       fndns;      /* of VgDiCacheFnDn */
+   VgDiCacheHdr  hdr;
+   Writer*       w;
+   HChar*        name;
+   HChar*        tmpname;
+   SysRes        fd;
+   UInt          n_fndn, n_cfsi_m, n_cfsi;
+   UWord         i;
+
+   vg_assert(VG_(clo_debuginfo_cache));
+   if (!cacheable(di))
+      return;
+
+   n_fndn   = di->fndnpool    ? VG_(sizeDedupPA)(di->fndnpool)    : 0;
+   n_cfsi_m = di->cfsi_m_pool ? VG_(sizeDedupPA)(di->cfsi_m_pool) : 0;
+
+   /* Gather the strings referred to by the fndn and inline tables. */
+   str_ht = VG_(HT_construct)("di.dicache.sdc.1");
+   strs   = VG_(newXA)(ML_(dinfo_zalloc), "di.dicache.sdc.2",
+                       ML_(dinfo_free), sizeof(HChar));
+   fndns  = VG_(newXA)(ML_(dinfo_zalloc), "di.dicache.sdc.3",
+                       ML_(dinfo_free), sizeof(VgDiCacheFnDn));
+   for (i = 1; i <= n_fndn; i++) {
+      const FnDn* fndn = VG_(indexEltNumber)(di->fndnpool, i);
+      VgDiCacheFnDn rec;
+      rec.filename = str_off(str_ht, strs, fndn->filename);
+      rec.dirname  = fndn->dirname ? str_off(str_ht, strs, fndn->dirname)
+                                   : NO_STR;
+      VG_(addToXA)(fndns, &rec);
+   }
+   for (i = 0; i < di->inltab_used; i++)
+      (void)str_off(str_ht, strs, INL_FNNAME(di, &di->inltab[i]));
+   while (VG_(sizeXA)(strs) % 8 != 0)
+      VG_(addBytesToXA)(strs, "", 1);
+
+   /* Holes in the CFI table are not written; they reappear when the
+      arrays are rebuilt from the remaining entries. */
+   n_cfsi = 0;
+   for (i = 0; i < di->cfsi_used; i++)
+      if (get_cfsi_m_ix(di, i) != 0)
+         n_cfsi++;
+
+   init_header(&hdr, cache_flags(have_dimg, have_aimg));
+   hdr.n_maps   = VG_(sizeXA)(di->fsm.maps);
+   hdr.n_strs   = VG_(sizeXA)(strs);
+   hdr.n_fndn   = n_fndn;
+   hdr.n_loc    = di->loctab_used;
+   hdr.n_inl    = di->inltab_used;
+   hdr.n_cfsi_m = n_cfsi_m;
+   hdr.n_cfsi   = n_cfsi;
+   hdr.n_exprs  = di->cfsi_exprs ? VG_(sizeXA)(di->cfsi_exprs) : 0;
+
+   /* Write to a temporary file and rename it into place, so that
+      concurrent runs never see a partially written file. */
+   name    = cache_file_name(buildid);
+   tmpname = ML_(dinfo_zalloc)("di.dicache.sdc.4", VG_(strlen)(name) + 20);
+   VG_(sprintf)(tmpname, "%s.%d", name, VG_(getpid)());
+   fd = VG_(open)(tmpname, VKI_O_CREAT|VKI_O_WRONLY|VKI_O_TRUNC,
+                  VKI_S_IRUSR|VKI_S_IWUSR|VKI_S_IRGRP|VKI_S_IROTH);
+   if (sr_isError(fd)) {
+      if (VG_(clo_verbosity) > 1)
+         VG_(message)(Vg_DebugMsg,
+                      "debuginfo cache: cannot create %s\n", tmpname);
+      goto out;
+   }
+
+   w = ML_(dinfo_zalloc)("di.dicache.sdc.5", sizeof(Writer));
+   w->fd = sr_Res(fd);
+
+   w_put(w, &hdr, sizeof(hdr));
+   for (i = 0; i < hdr.n_maps; i++) {
+      const DebugInfoMapping* map = VG_(indexXA)(di->fsm.maps, i);
+      VgDiCacheMap rec;
+      VG_(memset)(&rec, 0, sizeof(rec));
+      rec.rel_avma = map->avma - di->text_avma;
+      rec.size     = map->size;
+      rec.foff     = map->foff;
+      rec.prot     = map_prot(map);
+      w_put(w, &rec, sizeof(rec));
+   }
+   if (hdr.n_strs > 0)
+      w_put(w, VG_(indexXA)(strs, 0), hdr.n_strs);
+   if (n_fndn > 0)
+      w_put(w, VG_(indexXA)(fndns, 0), n_fndn * sizeof(VgDiCacheFnDn));
+   for (i = 0; i < di->loctab_used; i++) {
+      VgDiCacheLoc rec;
+      VG_(memset)(&rec, 0, sizeof(rec));
+      rec.rel_addr = di->loctab[i].addr - di->text_avma;
+      rec.size     = di->loctab[i].size;
+      rec.lineno   = di->loctab[i].lineno;
+      rec.fndn_ix  = ML_(fndn_ix)(di, i);
+      w_put(w, &rec, sizeof(rec));
+   }
+   for (i = 0; i < di->inltab_used; i++) {
+      VgDiCacheInl rec;
+      rec.rel_addr_lo = INL_ADDR_LO(di, &di->inltab[i]) - di->text_avma;
+      rec.rel_addr_hi = INL_ADDR_HI(di, &di->inltab[i]) - di->text_avma;
+      rec.inlinedfn   = str_off(str_ht, strs, INL_FNNAME(di, &di->inltab[i]));
+      rec.fndn_ix     = di->inltab[i].fndn_ix;
+      rec.lineno      = di->inltab[i].lineno;
+      rec.level       = di->inltab[i].level;
+      w_put(w, &rec, sizeof(rec));
+   }
+   for (i = 1; i <= n_cfsi_m; i++)
+      w_put(w, VG_(indexEltNumber)(di->cfsi_m_pool, i), sizeof(DiCfSI_m));
+   {
+      static const UChar zeroes[8] = { 0 };
+      w_put(w, zeroes, CFSI_M_SZB(n_cfsi_m) - n_cfsi_m * sizeof(DiCfSI_m));
+   }
+   for (i = 0; i < di->cfsi_used; i++) {
+      VgDiCacheCfSI rec;
+      Addr end = i + 1 < di->cfsi_used ? di->cfsi_base[i+1]
+                                       : di->cfsi_maxavma + 1;
+      rec.cfsi_m_ix = get_cfsi_m_ix(di, i);
+      if (rec.cfsi_m_ix == 0)
+         continue;
+      rec.rel_base = di->cfsi_base[i] - di->text_avma;
+      rec.len      = end - di->cfsi_base[i];
+      w_put(w, &rec, sizeof(rec));
+   }
+   if (hdr.n_exprs > 0)
+      w_put(w, VG_(indexXA)(di->cfsi_exprs, 0), hdr.n_exprs * sizeof(CfiExpr));
+   w_flush(w);
+   VG_(close)(w->fd);
+
+   if (w->failed || VG_(rename)(tmpname, name) != 0) {
+      if (VG_(clo_verbosity) > 1)
+         VG_(message)(Vg_DebugMsg,
+                      "debuginfo cache: cannot write %s\n", name);
+      VG_(unlink)(tmpname);
+   } else if (VG_(clo_verbosity) > 1) {
+      VG_(message)(Vg_DebugMsg, "debuginfo cache: wrote %s for %s\n",
+                   name, di->fsm.filename);
+   }
+   ML_(dinfo_free)(w);
+
+  out:
+   VG_(HT_destruct)(str_ht, ML_(dinfo_free));
+   VG_(deleteXA)(strs);
+   VG_(deleteXA)(fndns);
+   ML_(dinfo_free)(tmpname);
+   ML_(dinfo_free)(name);
+}
+
+/*--------------------------------------------------------------------*/
+/*--- end                                                dicache.c ---*/
+/*--------------------------------------------------------------------*/
@@ -41,6 +41,7 @@
 #include "pub_core_libcprint.h"
 #include "pub_core_libcproc.h"     /* VG_(read_millisecond_timer) */
 #include "pub_core_libcfile.h"
+#include "pub_core_aspacemgr.h"    /* VG_(am_mmap_file_float_valgrind) */
 #include "priv_misc.h"             /* dinfo_zalloc/free/strdup */
 #include "priv_image.h"            /* self */
 
@@ -53,6 +54,15 @@
 
 #define CACHE_ENTRY_SIZE      (1 << CACHE_ENTRY_SIZE_BITS)
 
+/* Local files up to this size are mapped in whole rather than read
+   through the cache.  On 32-bit hosts keep them small enough not to
+   eat a significant part of Valgrind's own address space. */
+#if VG_WORDSIZE == 8
+#  define MAP_MAX_SIZE  ((SizeT)16 << 30)
+#else
+#  define MAP_MAX_SIZE  ((SizeT)256 << 20)
+#endif
+
 /* An entry in the cache. */
 typedef
    struct {
@@ -84,6 +94,10 @@ struct _DiImage {
    Source source;
    // Total size of the image.
    SizeT size;
+   // For a local file that could be mapped, the whole file, read-only.
+   // All reads then come straight from here and the cache below is not
+   // used (ces_used stays 0).  NULL otherwise.
+   const UChar* map;
    // The number of entries used.  0 .. CACHE_N_ENTRIES
    UInt  ces_used;
    // Pointers to the entries.  ces[0 .. ces_used-1] are non-NULL.
@@ -592,10 +606,12 @@ static UChar get_slowcase ( DiImage* img, DiOffT off )
 // This is called a lot, so do the usual fast/slow split stuff on it. */
 static inline UChar get ( DiImage* img, DiOffT off )
 {
+   if (LIKELY(img->map != NULL))
+      return img->map[off];
    /* Most likely case is, it's in the ces[0] position. */
-   /* ML_(img_from_local_file) requests a read for ces[0] when
-      creating the image.  Hence slot zero is always non-NULL, so we
-      can skip this test. */
+   /* Unless it maps the file, ML_(img_from_local_file) requests a
+      read for ces[0] when creating the image.  Hence slot zero is
+      always non-NULL here, so we can skip this test. */
    if (LIKELY(/* img->ces[0] != NULL && */
               is_in_CEnt(img->ces[0], off))) {
       return img->ces[0]->data[ off - img->ces[0]->off ];
@@ -638,6 +654,20 @@ DiImage* ML_(img_from_local_file)(const HChar* fullpath)
    /* img->ces is already zeroed out */
    vg_assert(img->source.fd >= 0);
 
+   /* Best case: map the whole file, so that the readers work directly
+      on the file's bytes instead of having them copied through the
+      cache block by block.  This can fail, e.g. for lack of address
+      space or for files on filesystems that do not support mmap; in
+      that case just fall back to reading the file through the cache. */
+   if (size <= MAP_MAX_SIZE) {
+      SysRes sres = VG_(am_mmap_file_float_valgrind)
+                       ( (SizeT)size, VKI_PROT_READ, img->source.fd, 0 );
+      if (!sr_isError(sres)) {
+         img->map = (const UChar*)sr_Res(sres);
+         return img;
+      }
+   }
+
    /* Force the zeroth entry to be the first chunk of the file.
       That's likely to be the first part that's requested anyway, and
       loading it at this point forcing img->cent[0] to always be
@@ -771,6 +801,11 @@ void ML_(img_done)(DiImage* img)
       VG_(close)(img->source.fd);
    }
 
+   if (img->map) {
+      vg_assert(img->ces_used == 0);
+      VG_(am_munmap_valgrind)( (Addr)img->map, img->size );
+   }
+
    /* Free up the cache entries, ultimately |img| itself. */
    UInt i;
    vg_assert(img->ces_used <= CACHE_N_ENTRIES);
@@ -791,6 +826,12 @@ DiOffT ML_(img_size)(const DiImage* img)
    return img->size;
 }
 
+const HChar* ML_(img_local_name)(const DiImage* img)
+{
+   vg_assert(img != NULL);
+   return img->source.is_local ? img->source.name : NULL;
+}
+
 inline Bool ML_(img_valid)(const DiImage* img, DiOffT offset, SizeT size)
 {
    vg_assert(img);
@@ -833,6 +874,10 @@ void ML_(img_get)(/*OUT*/void* dst,
    vg_assert(img);
    vg_assert(size > 0);
    ensure_valid(img, offset, size, "ML_(img_get)");
+   if (img->map) {
+      VG_(memcpy)(dst, &img->map[offset], size);
+      return;
+   }
    SizeT i;
    for (i = 0; i < size; i++) {
       ((UChar*)dst)[i] = get(img, offset + i);
@@ -846,6 +891,10 @@ SizeT ML_(img_get_some)(/*OUT*/void* dst,
    vg_assert(size > 0);
    ensure_valid(img, offset, size, "ML_(img_get_some)");
    UChar* dstU = (UChar*)dst;
+   if (img->map) {
+      VG_(memcpy)(dstU, &img->map[offset], size);
+      return size;
+   }
    /* Use |get| in the normal way to get the first byte of the range.
       This guarantees to put the cache entry containing |offset| in
       position zero. */
@@ -0,0 +1,60 @@
+/* -*- mode: C; c-basic-offset: 3; -*- */
+
+/*--------------------------------------------------------------------*/
+/*--- On-disk cache of line number, inline and CFI tables.         ---*/
+/*---                                               priv_dicache.h ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   Copyright (C) 2015-2015 The Valgrind developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#ifndef __PRIV_DICACHE_H
+#define __PRIV_DICACHE_H
+
+#include "pub_core_basics.h"     // Bool
+#include "pub_core_debuginfo.h"  // DebugInfo
+
+/* Both of these are only to be called with --debuginfo-cache=<dir>.
+   BUILDID is the object's build-id as a hex string.  HAVE_DIMG and
+   HAVE_AIMG say whether a separate debug file and an alt debug file
+   were found for the object; a file written with different ones is
+   not used. */
+
+/* Look in the cache for the line number, inline and call frame info
+   of DI.  If it is there, add it to DI's (not yet canonicalised)
+   tables and return True. */
+extern Bool ML_(load_debuginfo_cache) ( DebugInfo* di, const HChar* buildid,
+                                        Bool have_dimg, Bool have_aimg );
+
+/* Write the line number, inline and call frame info of DI to the
+   cache.  DI must have been canonicalised, and ML_(finish_CFSI_arrays)
+   called on it. */
+extern void ML_(save_debuginfo_cache) ( DebugInfo* di, const HChar* buildid,
+                                        Bool have_dimg, Bool have_aimg );
+
+#endif /* ndef __PRIV_DICACHE_H */
+
+/*--------------------------------------------------------------------*/
+/*--- end                                           priv_dicache.h ---*/
+/*--------------------------------------------------------------------*/
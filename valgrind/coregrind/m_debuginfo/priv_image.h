@@ -77,6 +77,10 @@ void ML_(img_done)(DiImage*);
 /* How big is the image? */
 DiOffT ML_(img_size)(const DiImage* img);
 
+/* The full path of the file IMG was read from, or NULL if it was
+   read from a debuginfo server. */
+const HChar* ML_(img_local_name)(const DiImage* img);
+
 /* Does the section [offset, +size) exist in the image? */
 Bool ML_(img_valid)(const DiImage* img, DiOffT offset, SizeT size);
 
@@ -54,6 +54,16 @@ extern Bool ML_(is_elf_object_file)( const void* image, SizeT n_image,
 */
 extern Bool ML_(read_elf_debug_info) ( DebugInfo* di );
 
+/* With --lazy-debuginfo=yes, ML_(read_elf_debug_info) reads only the
+   symbol tables and leaves di->deferred_dwarf describing where the
+   rest is.  Read the call frame, line number and inline info now.
+   Returns False if the files could no longer be read.  Either way,
+   di->deferred_dwarf is NULL afterwards. */
+extern Bool ML_(read_elf_deferred_debug_info) ( DebugInfo* di );
+
+/* Forget about any debug info that has not been read yet. */
+extern void ML_(discard_deferred_debug_info) ( DebugInfo* di );
+
 
 #endif /* ndef __PRIV_READELF_H */
 
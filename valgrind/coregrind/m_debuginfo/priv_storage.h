@@ -129,19 +129,20 @@ typedef
 #define MAX_LEVEL     ((1 << LEVEL_BITS) - 1)
 
 /* A structure to hold addr-to-inlined fn info.  There
-   can be a lot of these, hence the dense packing.
+   can be a lot of these, hence the dense packing (20 bytes).
+   The start address is an offset from DebugInfo::inltab_base, and
+   the inlined fn name is an index in DebugInfo::inlfnpool: use
+   INL_ADDR_LO, INL_ADDR_HI and INL_FNNAME to get at them.
    Only caller source filename and lineno are stored.
    Handling dirname should be done using fndn_ix technique
    similar to  ML_(addLineInfo). */
 typedef
    struct {
-      /* Word 1 */
-      Addr   addr_lo;            /* lowest address for inlined fn */
-      /* Word 2 */
-      Addr   addr_hi;            /* highest address following the inlined fn */
-      /* Word 3 */
-      const HChar* inlinedfn;    /* inlined function name */
-      /* Word 4 and 5 */
+      Int    addr_lo_off;        /* lowest address for inlined fn,
+                                    relative to di->inltab_base */
+      UInt   size;               /* addr_hi - addr_lo */
+      UInt   inlinedfn_ix;       /* index in di->inlfnpool of the
+                                    inlined function name */
       UInt   fndn_ix;            /* index in di->fndnpool of caller source
                                     dirname/filename */
       UInt   lineno:LINENO_BITS; /* caller line number */
@@ -149,6 +150,31 @@ typedef
    }
    DiInlLoc;
 
+#define INL_ADDR_LO(_di,_inl) \
+   ((_di)->inltab_base + (Addr)(Word)(_inl)->addr_lo_off)
+#define INL_ADDR_HI(_di,_inl) (INL_ADDR_LO(_di,_inl) + (_inl)->size)
+#define INL_FNNAME(_di,_inl) \
+   (*(const HChar**)VG_(indexEltNumber)((_di)->inlfnpool, \
+                                        (_inl)->inlinedfn_ix))
+
+/* A sampled copy of the start addresses of one of the sorted address
+   tables (symtab, loctab, cfsi_base): key[k] is the address of table
+   entry k << DI_ADDRIX_SHIFT.  The keys are contiguous, so searching
+   them touches a few cache lines where a binary search of the table
+   itself would miss on nearly every probe; the search then finishes
+   within one block of 1 << DI_ADDRIX_SHIFT table entries.  n_elts is
+   the number of table entries when the index was built: a table that
+   has changed size since is searched without the index. */
+#define DI_ADDRIX_SHIFT 4
+
+typedef
+   struct {
+      Addr*  key;
+      UWord  n_keys;
+      UWord  n_elts;
+   }
+   DiAddrIx;
+
 /* --------------------- CF INFO --------------------- */
 
 /* DiCfSI: a structure to summarise DWARF2/3 CFA info for the code
@@ -856,6 +882,7 @@ struct _DebugInfo {
    DiSym*  symtab;
    UWord   symtab_used;
    UWord   symtab_size;
+   DiAddrIx symtab_ix;
    /* Two expandable arrays, storing locations and their filename/dirname. */
    DiLoc*  loctab;
    UInt    sizeof_fndn_ix;  /* Similar use as sizeof_cfsi_m_ix below. */
@@ -866,13 +893,18 @@ struct _DebugInfo {
                                depending on sizeof_fndn_ix. */
    UWord   loctab_used;
    UWord   loctab_size;
+   DiAddrIx loctab_ix;
    /* An expandable array of inlined fn info.
       maxinl_codesz is the biggest inlined piece of code
-      in inltab (i.e. the max of 'addr_hi - addr_lo'. */
+      in inltab (i.e. the max of 'addr_hi - addr_lo'.
+      inltab_base is the address the addr_lo_off of each entry is
+      relative to; it is the addr_lo of the first entry added. */
    DiInlLoc* inltab;
    UWord   inltab_used;
    UWord   inltab_size;
    SizeT   maxinl_codesz;
+   Addr    inltab_base;
+   DiAddrIx inltab_ix;
 
    /* A set of expandable arrays to store CFI summary info records.
       The machine specific information (i.e. the DiCfSI_m struct)
@@ -934,6 +966,7 @@ struct _DebugInfo {
                                    
    UWord   cfsi_used;
    UWord   cfsi_size;
+   DiAddrIx cfsi_ix;
 
    DedupPoolAlloc *cfsi_m_pool;
    Addr    cfsi_minavma;
@@ -956,6 +989,11 @@ struct _DebugInfo {
       Elements in the pool are allocated using VG_(allocFixedEltDedupPA). */
    DedupPoolAlloc *fndnpool;
 
+   /* Pool of the names of inlined functions, as const HChar* into
+      strpool.  Elements are allocated using VG_(allocFixedEltDedupPA),
+      so that DiInlLoc can refer to a name with a UInt. */
+   DedupPoolAlloc *inlfnpool;
+
    /* Variable scope information, as harvested from Dwarf3 files.
 
       In short it's an
@@ -996,6 +1034,20 @@ struct _DebugInfo {
       This helps performance a lot during ML_(addLineInfo) etc., which can
       easily be invoked hundreds of thousands of times. */
    DebugInfoMapping* last_rx_map;
+
+   /* With --lazy-debuginfo=yes: if not NULL, the call frame, line
+      number and inline info for this object has not been read yet.
+      The symbol table has.  See ML_(read_elf_deferred_debug_info). */
+   struct _DeferredDwarf* deferred_dwarf;
+
+   /* With --debuginfo-cache=<dir>: if not NULL, the build-id under
+      which to save the line number, inline and CFI tables once they
+      have been read and canonicalised.  NULL if they were loaded from
+      the cache.  The other two record which debug files were used,
+      as they are part of the cache key. */
+   HChar* cache_buildid;
+   Bool   cache_have_dimg;
+   Bool   cache_have_aimg;
 };
 
 /* --------------------- functions --------------------- */
@@ -1090,15 +1142,27 @@ extern void ML_(addVar)( struct _DebugInfo* di,
    this after finishing adding entries to these tables. */
 extern void ML_(canonicaliseTables) ( struct _DebugInfo* di );
 
+/* As ML_(canonicaliseTables), but leaving out the symbol table.  Call
+   this after reading deferred debug info (see .deferred_dwarf). */
+extern void ML_(canonicaliseDeferredTables) ( struct _DebugInfo* di );
+
 /* Canonicalise the call-frame-info table held by 'di', in preparation
    for use. This is called by ML_(canonicaliseTables) but can also be
    called on it's own to sort just this table. */
 extern void ML_(canonicaliseCFI) ( struct _DebugInfo* di );
 
 /* ML_(finish_CFSI_arrays) fills in the cfsi_base and cfsi_m_ix arrays
-   from cfsi_rd array. cfsi_rd is then freed. */
+   from cfsi_rd array, and indexes cfsi_base. cfsi_rd is then freed. */
 extern void ML_(finish_CFSI_arrays) ( struct _DebugInfo* di );
 
+/* Free the address index IX. */
+extern void ML_(free_addr_ix) ( DiAddrIx* ix );
+
+/* Narrow down the search of a table of N_ELTS entries indexed by IX for
+   the last entry starting at or below PTR to [*lo .. *hi]. */
+extern void ML_(addr_ix_range) ( const DiAddrIx* ix, UWord n_elts, Addr ptr,
+                                 Word* lo, Word* hi );
+
 /* ------ Searching ------ */
 
 /* Find a symbol-table index containing the specified pointer, or -1
@@ -37,6 +37,7 @@
 #include "pub_core_libcbase.h"
 #include "pub_core_libcprint.h"
 #include "pub_core_libcassert.h"
+#include "pub_core_libcfile.h"     /* VG_(stat) */
 #include "pub_core_machine.h"      /* VG_ELF_CLASS */
 #include "pub_core_options.h"
 #include "pub_core_oset.h"
@@ -51,6 +52,7 @@
 #include "priv_readdwarf.h"        /* 'cos ELF contains DWARF */
 #include "priv_readdwarf3.h"
 #include "priv_readexidx.h"
+#include "priv_dicache.h"
 
 /* --- !!! --- EXTERNAL HEADERS start --- !!! --- */
 #include <elf.h>
@@ -1423,6 +1425,288 @@ Word file_offset_from_svma ( /*OUT*/Bool* ok,
 }
 
 
+/* The DWARF sections (and .eh_frame) of an object, as far as they
+   are needed to read line number, call frame and inline info.  The
+   slices may be in the main, debug or alt debug image. */
+typedef
+   struct {
+      DiSlice ehframe[N_EHFRAME_SECTS]; // .eh_frame (di->n_ehframe of them)
+      DiSlice debug_frame;              // .debug_frame
+      DiSlice debug_info;               // .debug_info
+      DiSlice debug_types;              // .debug_types
+      DiSlice debug_abbv;               // .debug_abbrev
+      DiSlice debug_line;               // .debug_line
+      DiSlice debug_str;                // .debug_str
+      DiSlice debug_ranges;             // .debug_ranges
+      DiSlice debug_loc;                // .debug_loc
+      DiSlice debug_info_alt;           // .debug_info   (alt)
+      DiSlice debug_abbv_alt;           // .debug_abbrev (alt)
+      DiSlice debug_line_alt;           // .debug_line   (alt)
+      DiSlice debug_str_alt;            // .debug_str    (alt)
+   }
+   DwarfSects;
+
+#define N_DWARF_SECTS (sizeof(DwarfSects) / sizeof(DiSlice))
+
+/* Read the call frame info, line number info and (if wanted) the
+   variable and inline info from the sections in DS, and on ARM the
+   .exidx unwind tables. */
+static void read_elf_dwarf_info ( struct _DebugInfo* di, const DwarfSects* ds )
+{
+   UInt i;
+
+   /* Read .eh_frame and .debug_frame (call-frame-info) if any.  Do
+      the .eh_frame section(s) first. */
+   vg_assert(di->n_ehframe >= 0 && di->n_ehframe <= N_EHFRAME_SECTS);
+   for (i = 0; i < di->n_ehframe; i++) {
+      /* see Comment_on_EH_FRAME_MULTIPLE_INSTANCES above for why
+         this next assertion should hold. */
+      vg_assert(ML_(sli_is_valid)(ds->ehframe[i]));
+      vg_assert(ds->ehframe[i].szB == di->ehframe_size[i]);
+      ML_(read_callframe_info_dwarf3)( di,
+                                       ds->ehframe[i],
+                                       di->ehframe_avma[i],
+                                       True/*is_ehframe*/ );
+   }
+   if (ML_(sli_is_valid)(ds->debug_frame)) {
+      ML_(read_callframe_info_dwarf3)( di,
+                                       ds->debug_frame,
+                                       0/*assume zero avma*/,
+                                       False/*!is_ehframe*/ );
+   }
+
+   /* jrs 2006-01-01: icc-8.1 has been observed to generate
+      binaries without debug_str sections.  Don't preclude
+      debuginfo reading for that reason, but, in
+      read_unitinfo_dwarf2, do check that debugstr is non-NULL
+      before using it. */
+   if (ML_(sli_is_valid)(ds->debug_info)
+       && ML_(sli_is_valid)(ds->debug_abbv)
+       && ML_(sli_is_valid)(ds->debug_line)) {
+      /* The old reader: line numbers and unwind info only */
+      ML_(read_debuginfo_dwarf3) ( di,
+                                   ds->debug_info,
+                                   ds->debug_types,
+                                   ds->debug_abbv,
+                                   ds->debug_line,
+                                   ds->debug_str,
+                                   ds->debug_str_alt );
+      /* The new reader: read the DIEs in .debug_info to acquire
+         information on variable types and locations or inline info.
+         But only if the tool asks for it, or the user requests it on
+         the command line. */
+      if (VG_(clo_read_var_info) /* the user or tool asked for it */
+          || VG_(clo_read_inline_info)) {
+         ML_(new_dwarf3_reader)(
+            di, ds->debug_info,     ds->debug_types,
+                ds->debug_abbv,     ds->debug_line,
+                ds->debug_str,      ds->debug_ranges,
+                ds->debug_loc,      ds->debug_info_alt,
+                ds->debug_abbv_alt, ds->debug_line_alt,
+                ds->debug_str_alt
+         );
+      }
+   }
+
+   // JRS 31 July 2014: dwarf-1 reading is currently broken and
+   // therefore deactivated.
+   //if (dwarf1d_img && dwarf1l_img) {
+   //   ML_(read_debuginfo_dwarf1) ( di, dwarf1d_img, dwarf1d_sz, 
+   //                                    dwarf1l_img, dwarf1l_sz );
+   //}
+
+#  if defined(VGA_arm)
+   /* ARM32 only: read .exidx/.extab if present.  Note we are
+      reading these directly out of the mapped in (running) image.
+      Also, read these only if no CFI based unwind info was
+      acquired for this file.
+
+      An .exidx section is always required, but the .extab section
+      can be optionally omitted, provided that .exidx does not
+      refer to it.  If the .exidx is erroneous and does refer to
+      .extab even though .extab is missing, the range checks done
+      by GET_EX_U32 in ExtabEntryExtract in readexidx.c should
+      prevent any invalid memory accesses, and cause the .extab to
+      be rejected as invalid.
+
+      FIXME:
+      * check with m_aspacemgr that the entire [exidx_avma, +exidx_size)
+        and [extab_avma, +extab_size) areas are readable, since we're
+        reading this stuff out of the running image (not from a file/socket)
+        and we don't want to segfault.
+      * DebugInfo::exidx_bias and use text_bias instead.
+        I think it's always the same.
+      * remove DebugInfo::{extab_bias, exidx_svma, extab_svma} since
+        they are never used.
+   */
+   if (di->exidx_present
+       && di->cfsi_used == 0
+       && di->text_present && di->text_size > 0) {
+      Addr text_last_svma = di->text_svma + di->text_size - 1;
+      ML_(read_exidx)( di, (UChar*)di->exidx_avma, di->exidx_size,
+                           (UChar*)di->extab_avma, di->extab_size,
+                           text_last_svma,
+                           di->exidx_bias );
+   }
+#  endif /* defined(VGA_arm) */
+}
+
+
+/* With --lazy-debuginfo=yes, read_elf_dwarf_info is not called when
+   the object is mapped.  Instead we remember where its sections are,
+   as offsets in up to three images (main, debug and alt debug file),
+   and read them when ML_(read_elf_deferred_debug_info) is called.
+   The images are closed in between, so as not to hold a file
+   descriptor per object; they are reopened by name, and the deferred
+   info is dropped if a file is not the one seen at first: if its
+   size, device, inode or modification time has changed meanwhile. */
+#define N_DEFERRED_IMGS 3
+
+typedef
+   struct {
+      DiOffT szB;
+      ULong  dev;
+      ULong  ino;
+      ULong  mtime;
+      ULong  mtime_nsec;
+   }
+   DeferredImgId;
+
+struct _DeferredDwarf {
+   HChar*        img_name[N_DEFERRED_IMGS];   // NULL if not used
+   DeferredImgId img_id[N_DEFERRED_IMGS];
+   /* For each slice in a DwarfSects: which image it is in (-1 if
+      it is DiSlice_INVALID), and where. */
+   struct { Int img; DiOffT ioff; DiOffT szB; } sect[N_DWARF_SECTS];
+};
+
+/* Fill in *ID for the local file NAME, whose image is IMG.  Returns
+   False if the file cannot be stat'd. */
+static Bool get_deferred_img_id ( /*OUT*/DeferredImgId* id,
+                                  const HChar* name, DiImage* img )
+{
+   struct vg_stat st;
+   SysRes sres = VG_(stat)(name, &st);
+   if (sr_isError(sres))
+      return False;
+   id->szB        = ML_(img_size)(img);
+   id->dev        = st.dev;
+   id->ino        = st.ino;
+   id->mtime      = st.mtime;
+   id->mtime_nsec = st.mtime_nsec;
+   return True;
+}
+
+/* Returns True if the DWARF info for DI can be read later, which is
+   only possible if all the images involved are local files.  */
+static Bool defer_elf_dwarf_info ( struct _DebugInfo* di,
+                                   const DwarfSects* ds,
+                                   DiImage* mimg, DiImage* dimg,
+                                   DiImage* aimg )
+{
+   DiImage* imgs[N_DEFERRED_IMGS] = { mimg, dimg, aimg };
+   const DiSlice* sl = (const DiSlice*)ds;
+   struct _DeferredDwarf* dd;
+   UInt i, k;
+
+   if (!VG_(clo_lazy_debuginfo) || VG_(clo_read_var_info))
+      return False;
+   for (k = 0; k < N_DEFERRED_IMGS; k++)
+      if (imgs[k] && ML_(img_local_name)(imgs[k]) == NULL)
+         return False;
+
+   dd = ML_(dinfo_zalloc)("di.readelf.deferred.1", sizeof(*dd));
+   for (k = 0; k < N_DEFERRED_IMGS; k++) {
+      if (imgs[k] == NULL)
+         continue;
+      dd->img_name[k] = ML_(dinfo_strdup)("di.readelf.deferred.2",
+                                          ML_(img_local_name)(imgs[k]));
+      if (!get_deferred_img_id(&dd->img_id[k], dd->img_name[k], imgs[k])) {
+         di->deferred_dwarf = dd;
+         ML_(discard_deferred_debug_info)(di);
+         return False;
+      }
+   }
+   for (i = 0; i < N_DWARF_SECTS; i++) {
+      dd->sect[i].img = -1;
+      if (!ML_(sli_is_valid)(sl[i]))
+         continue;
+      for (k = 0; k < N_DEFERRED_IMGS; k++)
+         if (sl[i].img == imgs[k])
+            break;
+      vg_assert(k < N_DEFERRED_IMGS);
+      dd->sect[i].img  = k;
+      dd->sect[i].ioff = sl[i].ioff;
+      dd->sect[i].szB  = sl[i].szB;
+   }
+   di->deferred_dwarf = dd;
+   return True;
+}
+
+void ML_(discard_deferred_debug_info) ( struct _DebugInfo* di )
+{
+   struct _DeferredDwarf* dd = di->deferred_dwarf;
+   UInt k;
+
+   if (dd == NULL)
+      return;
+   for (k = 0; k < N_DEFERRED_IMGS; k++)
+      if (dd->img_name[k])
+         ML_(dinfo_free)(dd->img_name[k]);
+   ML_(dinfo_free)(dd);
+   di->deferred_dwarf = NULL;
+}
+
+Bool ML_(read_elf_deferred_debug_info) ( struct _DebugInfo* di )
+{
+   struct _DeferredDwarf* dd = di->deferred_dwarf;
+   DiImage*   imgs[N_DEFERRED_IMGS] = { NULL, NULL, NULL };
+   DwarfSects ds;
+   DiSlice*   sl = (DiSlice*)&ds;
+   Bool       ok = True;
+   UInt       i, k;
+
+   vg_assert(dd);
+   vg_assert(di->have_dinfo);
+
+   for (k = 0; k < N_DEFERRED_IMGS && ok; k++) {
+      DeferredImgId id;
+      if (dd->img_name[k] == NULL)
+         continue;
+      imgs[k] = ML_(img_from_local_file)(dd->img_name[k]);
+      if (imgs[k] == NULL
+          || !get_deferred_img_id(&id, dd->img_name[k], imgs[k])
+          || id.szB != dd->img_id[k].szB
+          || id.dev != dd->img_id[k].dev
+          || id.ino != dd->img_id[k].ino
+          || id.mtime != dd->img_id[k].mtime
+          || id.mtime_nsec != dd->img_id[k].mtime_nsec) {
+         if (VG_(clo_verbosity) > 1)
+            VG_(message)(Vg_DebugMsg,
+                         "lazy debuginfo: %s has changed, not reading it\n",
+                         dd->img_name[k]);
+         ok = False;
+      }
+   }
+
+   if (ok) {
+      for (i = 0; i < N_DWARF_SECTS; i++) {
+         sl[i] = dd->sect[i].img < 0
+                    ? DiSlice_INVALID
+                    : mk_DiSlice(imgs[dd->sect[i].img],
+                                 dd->sect[i].ioff, dd->sect[i].szB);
+      }
+      read_elf_dwarf_info(di, &ds);
+   }
+
+   for (k = 0; k < N_DEFERRED_IMGS; k++)
+      if (imgs[k])
+         ML_(img_done)(imgs[k]);
+   ML_(discard_deferred_debug_info)(di);
+   return ok;
+}
+
+
 /* The central function for reading ELF debug info.  For the
    object/exe specified by the DebugInfo, find ELF sections, then read
    the symbols, line number info, file name info, CFA (stack-unwind
@@ -2888,104 +3172,47 @@ Bool ML_(read_elf_debug_info) ( struct _DebugInfo* di )
       }
 
       /* TOPLEVEL */
-      /* Read .eh_frame and .debug_frame (call-frame-info) if any.  Do
-         the .eh_frame section(s) first. */
-      vg_assert(di->n_ehframe >= 0 && di->n_ehframe <= N_EHFRAME_SECTS);
-      for (i = 0; i < di->n_ehframe; i++) {
-         /* see Comment_on_EH_FRAME_MULTIPLE_INSTANCES above for why
-            this next assertion should hold. */
-         vg_assert(ML_(sli_is_valid)(ehframe_escn[i]));
-         vg_assert(ehframe_escn[i].szB == di->ehframe_size[i]);
-         ML_(read_callframe_info_dwarf3)( di,
-                                          ehframe_escn[i],
-                                          di->ehframe_avma[i],
-                                          True/*is_ehframe*/ );
-      }
-      if (ML_(sli_is_valid)(debug_frame_escn)) {
-         ML_(read_callframe_info_dwarf3)( di,
-                                          debug_frame_escn,
-                                          0/*assume zero avma*/,
-                                          False/*!is_ehframe*/ );
-      }
-
-      /* TOPLEVEL */
-      /* jrs 2006-01-01: icc-8.1 has been observed to generate
-         binaries without debug_str sections.  Don't preclude
-         debuginfo reading for that reason, but, in
-         read_unitinfo_dwarf2, do check that debugstr is non-NULL
-         before using it. */
-      if (ML_(sli_is_valid)(debug_info_escn) 
-          && ML_(sli_is_valid)(debug_abbv_escn)
-          && ML_(sli_is_valid)(debug_line_escn)) {
-         /* The old reader: line numbers and unwind info only */
-         ML_(read_debuginfo_dwarf3) ( di,
-                                      debug_info_escn,
-                                      debug_types_escn,
-                                      debug_abbv_escn,
-                                      debug_line_escn,
-                                      debug_str_escn,
-                                      debug_str_alt_escn );
-         /* The new reader: read the DIEs in .debug_info to acquire
-            information on variable types and locations or inline info.
-            But only if the tool asks for it, or the user requests it on
-            the command line. */
-         if (VG_(clo_read_var_info) /* the user or tool asked for it */
-             || VG_(clo_read_inline_info)) {
-            ML_(new_dwarf3_reader)(
-               di, debug_info_escn,     debug_types_escn,
-                   debug_abbv_escn,     debug_line_escn,
-                   debug_str_escn,      debug_ranges_escn,
-                   debug_loc_escn,      debug_info_alt_escn,
-                   debug_abbv_alt_escn, debug_line_alt_escn,
-                   debug_str_alt_escn
-            );
+      /* Read .eh_frame and .debug_frame (call-frame-info), line
+         number info and inline/variable info, or arrange for them to
+         be read when first needed. */
+      {
+         DwarfSects ds;
+         for (i = 0; i < N_EHFRAME_SECTS; i++)
+            ds.ehframe[i] = ehframe_escn[i];
+         ds.debug_frame    = debug_frame_escn;
+         ds.debug_info     = debug_info_escn;
+         ds.debug_types    = debug_types_escn;
+         ds.debug_abbv     = debug_abbv_escn;
+         ds.debug_line     = debug_line_escn;
+         ds.debug_str      = debug_str_escn;
+         ds.debug_ranges   = debug_ranges_escn;
+         ds.debug_loc      = debug_loc_escn;
+         ds.debug_info_alt = debug_info_alt_escn;
+         ds.debug_abbv_alt = debug_abbv_alt_escn;
+         ds.debug_line_alt = debug_line_alt_escn;
+         ds.debug_str_alt  = debug_str_alt_escn;
+
+         /* Variable info is not cached, so the DWARF has to be read
+            anyway if that is wanted. */
+         HChar* cache_buildid = NULL;
+         if (VG_(clo_debuginfo_cache) && !VG_(clo_read_var_info))
+            cache_buildid = find_buildid(mimg, False, False);
+
+         if (cache_buildid
+             && ML_(load_debuginfo_cache)(di, cache_buildid,
+                                          dimg != NULL, aimg != NULL)) {
+            ML_(dinfo_free)(cache_buildid);
+         } else {
+            if (cache_buildid) {
+               di->cache_buildid   = cache_buildid;
+               di->cache_have_dimg = dimg != NULL;
+               di->cache_have_aimg = aimg != NULL;
+            }
+            if (!defer_elf_dwarf_info(di, &ds, mimg, dimg, aimg))
+               read_elf_dwarf_info(di, &ds);
          }
       }
 
-      /* TOPLEVEL */
-      // JRS 31 July 2014: dwarf-1 reading is currently broken and
-      // therefore deactivated.
-      //if (dwarf1d_img && dwarf1l_img) {
-      //   ML_(read_debuginfo_dwarf1) ( di, dwarf1d_img, dwarf1d_sz, 
-      //                                    dwarf1l_img, dwarf1l_sz );
-      //}
-
-#     if defined(VGA_arm)
-      /* TOPLEVEL */
-      /* ARM32 only: read .exidx/.extab if present.  Note we are
-         reading these directly out of the mapped in (running) image.
-         Also, read these only if no CFI based unwind info was
-         acquired for this file.
-
-         An .exidx section is always required, but the .extab section
-         can be optionally omitted, provided that .exidx does not
-         refer to it.  If the .exidx is erroneous and does refer to
-         .extab even though .extab is missing, the range checks done
-         by GET_EX_U32 in ExtabEntryExtract in readexidx.c should
-         prevent any invalid memory accesses, and cause the .extab to
-         be rejected as invalid.
-
-         FIXME:
-         * check with m_aspacemgr that the entire [exidx_avma, +exidx_size)
-           and [extab_avma, +extab_size) areas are readable, since we're
-           reading this stuff out of the running image (not from a file/socket)
-           and we don't want to segfault.
-         * DebugInfo::exidx_bias and use text_bias instead.
-           I think it's always the same.
-         * remove DebugInfo::{extab_bias, exidx_svma, extab_svma} since
-           they are never used.
-      */
-      if (di->exidx_present
-          && di->cfsi_used == 0
-          && di->text_present && di->text_size > 0) {
-         Addr text_last_svma = di->text_svma + di->text_size - 1;
-         ML_(read_exidx)( di, (UChar*)di->exidx_avma, di->exidx_size,
-                              (UChar*)di->extab_avma, di->extab_size,
-                              text_last_svma,
-                              di->exidx_bias );
-      }
-#     endif /* defined(VGA_arm) */
-
    } /* "Find interesting sections, read the symbol table(s), read any debug
         information" (a local scope) */
 
@@ -584,7 +584,7 @@ static void addInl ( struct _DebugInfo* di, DiInlLoc* inl )
    DiInlLoc* new_tab;
 
    /* empty inl should have been ignored earlier */
-   vg_assert(inl->addr_lo < inl->addr_hi);
+   vg_assert(inl->size > 0);
 
    if (di->inltab_used == di->inltab_size) {
       new_sz = 2 * di->inltab_size;
@@ -601,8 +601,8 @@ static void addInl ( struct _DebugInfo* di, DiInlLoc* inl )
    }
 
    di->inltab[di->inltab_used] = *inl;
-   if (inl->addr_hi - inl->addr_lo > di->maxinl_codesz)
-      di->maxinl_codesz = inl->addr_hi - inl->addr_lo;
+   if (inl->size > di->maxinl_codesz)
+      di->maxinl_codesz = inl->size;
    di->inltab_used++;
    vg_assert(di->inltab_used <= di->inltab_size);
 }
@@ -628,6 +628,7 @@ void ML_(addInlInfo) ( struct _DebugInfo* di,
                        Int lineno, UShort level)
 {
    DiInlLoc inl;
+   Word     lo_off;
 
    /* Similar paranoia as in ML_(addLineInfo). Unclear if needed. */
    if (addr_lo >= addr_hi) {
@@ -656,10 +657,38 @@ void ML_(addInlInfo) ( struct _DebugInfo* di,
       return;
    }
 
+   /* Addresses are stored relative to the first one added, in 32 bits.
+      An object whose inlined code spans more than 2GB is not something
+      we expect to see. */
+   if (di->inltab_used == 0)
+      di->inltab_base = addr_lo;
+   lo_off = (Word)(addr_lo - di->inltab_base);
+   if (lo_off != (Word)(Int)lo_off || addr_hi - addr_lo > 0xFFFFFFFFUL) {
+      static Bool complained = False;
+      if (!complained) {
+         complained = True;
+         VG_(message)(Vg_UserMsg, 
+                      "warning: ignoring inlined call info entry with "
+                      "out of range address 0x%lx-0x%lx\n", addr_lo, addr_hi);
+         VG_(message)(Vg_UserMsg, 
+                      "(Nb: this message is only shown once)\n");
+      }
+      return;
+   }
+
+   if (UNLIKELY(di->inlfnpool == NULL))
+      di->inlfnpool = VG_(newDedupPA)(500,
+                                      vg_alignof(const HChar*),
+                                      ML_(dinfo_zalloc),
+                                      "di.storage.addInlInfo.1",
+                                      ML_(dinfo_free));
+
    // code resulting from inlining of inlinedfn:
-   inl.addr_lo   = addr_lo;
-   inl.addr_hi   = addr_hi;
-   inl.inlinedfn = inlinedfn;
+   inl.addr_lo_off  = (Int)lo_off;
+   inl.size         = (UInt)(addr_hi - addr_lo);
+   inl.inlinedfn_ix = VG_(allocFixedEltDedupPA) (di->inlfnpool,
+                                                 sizeof(const HChar*),
+                                                 &inlinedfn);
    // caller:
    inl.fndn_ix   = fndn_ix;
    inl.lineno    = lineno;
@@ -1641,6 +1670,71 @@ void add_DiSym_names_to_from ( const DebugInfo* di, DiSym* to,
 }
 
 
+/*------------------------------------------------------------*/
+/*--- Address indexes                                      ---*/
+/*------------------------------------------------------------*/
+
+/* (Re)build IX over the N_ELTS entries of sorted table TAB, whose
+   entries are SZB bytes long and have their start address at offset
+   KEY_OFF. */
+static void build_addr_ix ( DiAddrIx* ix, const HChar* cc,
+                            const void* tab, SizeT szB, SizeT key_off,
+                            UWord n_elts )
+{
+   UWord k;
+
+   ML_(free_addr_ix) (ix);
+   ix->n_elts = n_elts;
+   /* Not worth it for a table that fits in a couple of blocks. */
+   if (n_elts <= 2 << DI_ADDRIX_SHIFT)
+      return;
+
+   ix->n_keys = ((n_elts - 1) >> DI_ADDRIX_SHIFT) + 1;
+   ix->key = ML_(dinfo_zalloc) (cc, ix->n_keys * sizeof(Addr));
+   for (k = 0; k < ix->n_keys; k++)
+      ix->key[k] = *(const Addr*)((const UChar*)tab
+                                  + (k << DI_ADDRIX_SHIFT) * szB + key_off);
+}
+
+void ML_(free_addr_ix) ( DiAddrIx* ix )
+{
+   if (ix->key)
+      ML_(dinfo_free) (ix->key);
+   ix->key = NULL;
+   ix->n_keys = 0;
+   ix->n_elts = 0;
+}
+
+/* Narrow down the search of a table of N_ELTS entries indexed by IX for
+   the last entry starting at or below PTR to [*lo .. *hi].  The range
+   is empty if PTR is below the first entry. */
+void ML_(addr_ix_range) ( const DiAddrIx* ix, UWord n_elts, Addr ptr,
+                          Word* lo, Word* hi )
+{
+   Word klo, khi, kmid;
+
+   *lo = 0;
+   *hi = (Word)n_elts - 1;
+   if (ix->key == NULL || ix->n_elts != n_elts)
+      return;
+
+   /* Find the last key <= ptr. */
+   klo = 0;
+   khi = ix->n_keys - 1;
+   while (klo <= khi) {
+      kmid = (klo + khi) / 2;
+      if (ptr < ix->key[kmid]) khi = kmid - 1; else klo = kmid + 1;
+   }
+   if (khi < 0) {
+      *hi = -1;
+      return;
+   }
+   *lo = khi << DI_ADDRIX_SHIFT;
+   if (*lo + (1 << DI_ADDRIX_SHIFT) - 1 < *hi)
+      *hi = *lo + (1 << DI_ADDRIX_SHIFT) - 1;
+}
+
+
 static void canonicaliseSymtab ( struct _DebugInfo* di )
 {
    Word  i, j, n_truncated;
@@ -2061,8 +2155,8 @@ static Int compare_DiInlLoc ( const void* va, const void* vb )
 {
    const DiInlLoc* a = va;
    const DiInlLoc* b = vb;
-   if (a->addr_lo < b->addr_lo) return -1;
-   if (a->addr_lo > b->addr_lo) return  1;
+   if (a->addr_lo_off < b->addr_lo_off) return -1;
+   if (a->addr_lo_off > b->addr_lo_off) return  1;
    return 0;
 }
 
@@ -2080,13 +2174,27 @@ static void canonicaliseInltab ( struct _DebugInfo* di )
    /* Ensure relevant postconditions hold. */
    for (i = 0; i < ((Word)di->inltab_used)-1; i++) {
       /* No zero-sized inlined call. */
-      vg_assert(di->inltab[i].addr_lo < di->inltab[i].addr_hi);
+      vg_assert(di->inltab[i].size > 0);
       /* In order, but we can have duplicates and overlapping ranges. */
-      vg_assert(di->inltab[i].addr_lo <= di->inltab[i+1].addr_lo);
+      vg_assert(di->inltab[i].addr_lo_off <= di->inltab[i+1].addr_lo_off);
    }
 
    /* Free up unused space at the end of the table. */
    shrinkInlTab(di);
+
+   /* Index the start addresses.  build_addr_ix wants an Addr in each
+      entry, which a DiInlLoc no longer has, so do it by hand. */
+   ML_(free_addr_ix) (&di->inltab_ix);
+   di->inltab_ix.n_elts = di->inltab_used;
+   if (di->inltab_used > 2 << DI_ADDRIX_SHIFT) {
+      DiAddrIx* ix = &di->inltab_ix;
+      UWord k;
+      ix->n_keys = ((di->inltab_used - 1) >> DI_ADDRIX_SHIFT) + 1;
+      ix->key = ML_(dinfo_zalloc) ("di.storage.cIT.1",
+                                   ix->n_keys * sizeof(Addr));
+      for (k = 0; k < ix->n_keys; k++)
+         ix->key[k] = INL_ADDR_LO(di, &di->inltab[k << DI_ADDRIX_SHIFT]);
+   }
 }
 
 
@@ -2312,6 +2420,9 @@ void ML_(finish_CFSI_arrays) ( struct _DebugInfo* di )
    di->cfsi_size = new_used;
    ML_(dinfo_free) (di->cfsi_rd);
    di->cfsi_rd = NULL;
+
+   build_addr_ix (&di->cfsi_ix, "di.storage.finCfSI.3",
+                  di->cfsi_base, sizeof(Addr), 0, di->cfsi_used);
 }
 
 
@@ -2320,16 +2431,34 @@ void ML_(finish_CFSI_arrays) ( struct _DebugInfo* di )
 void ML_(canonicaliseTables) ( struct _DebugInfo* di )
 {
    canonicaliseSymtab ( di );
+   build_addr_ix ( &di->symtab_ix, "di.storage.cTa.1",
+                   di->symtab, sizeof(DiSym),
+                   offsetof(DiSym, avmas.main), di->symtab_used );
+   ML_(canonicaliseDeferredTables) ( di );
+}
+
+/* Canonicalise all tables but the symbol table.  Also called, on its
+   own, once deferred debug info has been read in. */
+void ML_(canonicaliseDeferredTables) ( struct _DebugInfo* di )
+{
    canonicaliseLoctab ( di );
+   build_addr_ix ( &di->loctab_ix, "di.storage.cDT.1",
+                   di->loctab, sizeof(DiLoc),
+                   offsetof(DiLoc, addr), di->loctab_used );
    canonicaliseInltab ( di );
    ML_(canonicaliseCFI) ( di );
+   canonicaliseVarInfo ( di );
+   /* The deferred readers will still add to the pools. */
+   if (di->deferred_dwarf)
+      return;
    if (di->cfsi_m_pool)
       VG_(freezeDedupPA) (di->cfsi_m_pool, ML_(dinfo_shrink_block));
-   canonicaliseVarInfo ( di );
    if (di->strpool)
       VG_(freezeDedupPA) (di->strpool, ML_(dinfo_shrink_block));
    if (di->fndnpool)
       VG_(freezeDedupPA) (di->fndnpool, ML_(dinfo_shrink_block));
+   if (di->inlfnpool)
+      VG_(freezeDedupPA) (di->inlfnpool, ML_(dinfo_shrink_block));
 }
 
 
@@ -2345,9 +2474,8 @@ Word ML_(search_one_symtab) ( const DebugInfo* di, Addr ptr,
                               Bool findText )
 {
    Addr a_mid_lo, a_mid_hi;
-   Word mid, size, 
-        lo = 0, 
-        hi = di->symtab_used-1;
+   Word mid, size, lo, hi;
+   ML_(addr_ix_range) (&di->symtab_ix, di->symtab_used, ptr, &lo, &hi);
    while (True) {
       /* current unsearched space is from lo to hi, inclusive. */
       if (lo > hi) return -1; /* not found */
@@ -2376,9 +2504,8 @@ Word ML_(search_one_symtab) ( const DebugInfo* di, Addr ptr,
 Word ML_(search_one_loctab) ( const DebugInfo* di, Addr ptr )
 {
    Addr a_mid_lo, a_mid_hi;
-   Word mid, 
-        lo = 0, 
-        hi = di->loctab_used-1;
+   Word mid, lo, hi;
+   ML_(addr_ix_range) (&di->loctab_ix, di->loctab_used, ptr, &lo, &hi);
    while (True) {
       /* current unsearched space is from lo to hi, inclusive. */
       if (lo > hi) return -1; /* not found */
@@ -2399,10 +2526,9 @@ Word ML_(search_one_loctab) ( const DebugInfo* di, Addr ptr )
 
 Word ML_(search_one_cfitab) ( const DebugInfo* di, Addr ptr )
 {
-   Word mid, 
-        lo = 0, 
-        hi = di->cfsi_used-1;
+   Word mid, lo, hi;
 
+   ML_(addr_ix_range) (&di->cfsi_ix, di->cfsi_used, ptr, &lo, &hi);
    while (lo <= hi) {
       /* Invariants : hi == cfsi_used-1 || ptr < cfsi_base[hi+1]
                       lo == 0           || ptr > cfsi_base[lo-1]
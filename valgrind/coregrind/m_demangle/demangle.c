@@ -34,6 +34,7 @@
 #include "pub_core_libcbase.h"
 #include "pub_core_libcprint.h"
 #include "pub_core_mallocfree.h"
+#include "pub_core_deduppoolalloc.h"
 #include "pub_core_options.h"
 
 #include "vg_libciface.h"
@@ -81,11 +82,96 @@
    To update to a newer libiberty, use the "update-demangler" script
    which is included in the valgrind repository. */
 
+/* C++ demangling is slow, particularly for template-heavy names, and
+   the same few names get demangled again and again, each time a stack
+   trace is printed or matched against a suppression.  So the results
+   are kept in a direct-mapped cache, indexed by a hash of the mangled
+   name.  Both names are stored in a dedup pool, which is thrown away,
+   emptying the cache, once it has grown to DM_CACHE_MAX_SZB.  That can
+   only happen inside VG_(demangle), so a name it returned stays valid
+   at least until the next call, as promised below.  Names that do not
+   fit in a pool are not cached; such a demangled name is kept in
+   dm_uncached until the next call instead. */
+#define N_DM_CACHE        4096   /* power of 2 */
+#define DM_CACHE_MAX_SZB  (1024 * 1024)
+#define DM_CACHE_POOL_SZB (64 * 1024)
+
+typedef
+   struct {
+      const HChar* mangled;    /* NULL if the entry is unused */
+      const HChar* demangled;  /* NULL if not a C++ name */
+   }
+   DmCacheEnt;
+
+static DmCacheEnt      dm_cache[N_DM_CACHE];
+static DedupPoolAlloc* dm_cache_pool = NULL;
+static SizeT           dm_cache_szB  = 0;
+static HChar*          dm_uncached   = NULL;
+
+static void* dm_cache_alloc ( const HChar* cc, SizeT szB )
+{
+   return VG_(arena_malloc)(VG_AR_DEMANGLE, cc, szB);
+}
+
+static void dm_cache_free ( void* p )
+{
+   VG_(arena_free)(VG_AR_DEMANGLE, p);
+}
+
+static const HChar* dm_cache_strdup ( const HChar* str )
+{
+   SizeT szB = VG_(strlen)(str) + 1;
+   dm_cache_szB += szB;
+   return VG_(allocEltDedupPA)(dm_cache_pool, szB, str);
+}
+
+static const HChar* cxx_demangle_cached ( const HChar* orig )
+{
+   UInt h = 0;
+   const HChar* p;
+   DmCacheEnt* ent;
+   HChar* demangled;
+
+   if (dm_uncached) {
+      VG_(arena_free) (VG_AR_DEMANGLE, dm_uncached);
+      dm_uncached = NULL;
+   }
+
+   for (p = orig; *p; p++)
+      h = h * 31 + (UChar)*p;
+   ent = &dm_cache[(h ^ (h >> 16)) & (N_DM_CACHE - 1)];
+   if (ent->mangled && VG_(strcmp)(ent->mangled, orig) == 0)
+      return ent->demangled ? ent->demangled : orig;
+
+   demangled = ML_(cplus_demangle) ( orig, DMGL_ANSI | DMGL_PARAMS );
+
+   if (p - orig + 1 > DM_CACHE_POOL_SZB
+       || (demangled && VG_(strlen)(demangled) + 1 > DM_CACHE_POOL_SZB)) {
+      dm_uncached = demangled;
+      return demangled ? demangled : orig;
+   }
+
+   if (dm_cache_pool == NULL || dm_cache_szB > DM_CACHE_MAX_SZB) {
+      if (dm_cache_pool)
+         VG_(deleteDedupPA)(dm_cache_pool);
+      VG_(memset)(dm_cache, 0, sizeof(dm_cache));
+      dm_cache_pool = VG_(newDedupPA)(DM_CACHE_POOL_SZB, 1, dm_cache_alloc,
+                                      "demangle.cache", dm_cache_free);
+      dm_cache_szB = 0;
+   }
+   ent->mangled   = dm_cache_strdup(orig);
+   ent->demangled = demangled ? dm_cache_strdup(demangled) : NULL;
+   if (demangled)
+      VG_(arena_free) (VG_AR_DEMANGLE, demangled);
+
+   return ent->demangled ? ent->demangled : orig;
+}
+
 /* This is the main, standard demangler entry point. */
 
 /* Upon return, *RESULT will point to the demangled name.
    The memory buffer that holds the demangled name is allocated on the
-   heap and will be deallocated in the next invocation. Conceptually,
+   heap and may be deallocated in the next invocation. Conceptually,
    that buffer is owned by VG_(demangle). That means two things:
    (1) Users of VG_(demangle) must not free that buffer.
    (2) If the demangled name needs to be stashed away for later use,
@@ -112,14 +198,7 @@ void VG_(demangle) ( Bool do_cxx_demangling, Bool do_z_demangling,
 
    /* Possibly undo (1) */
    if (do_cxx_demangling && VG_(clo_demangle)) {
-      static HChar* demangled = NULL;
-
-      /* Free up previously demangled name */
-      if (demangled) VG_(arena_free) (VG_AR_DEMANGLE, demangled);
-
-      demangled = ML_(cplus_demangle) ( orig, DMGL_ANSI | DMGL_PARAMS );
-
-      *result = (demangled == NULL) ? orig : demangled;
+      *result = cxx_demangle_cached ( orig );
    } else {
       *result = orig;
    }
@@ -69,9 +69,20 @@
 #define M_COLLECT_NO_ERRORS_AFTER_FOUND 10000000
 
 /* The list of error contexts found, both suppressed and unsuppressed.
-   Initially empty, and grows as errors are detected. */
+   Initially empty, and grows as errors are detected.  The most recently
+   seen error is at the front. */
 static Error* errors = NULL;
 
+/* The same errors, hashed by kind and the top of their stack trace
+   (see hash_Error), so that VG_(maybe_record_error) does not have to
+   compare a new error against every one seen so far.  Grows when the
+   chains get long. */
+static Error** errtab      = NULL;
+static UInt    errtab_size = 0;
+static UInt    errtab_used = 0;
+
+#define ERRTAB_INIT_SIZE 1024
+
 /* The list of suppression directives, as read from the specified
    suppressions file.  Note that the list gets rearranged as a result
    of the searches done by is_suppressible_error(). */
@@ -105,6 +116,9 @@ static UWord em_errlist_searches = 0;
    searching. */
 static UWord em_errlist_cmps = 0;
 
+/* Stats: number of times the error hash table was resized. */
+static UWord em_errtab_resizes = 0;
+
 /* Stats: number of searches of the suppression list initiated. */
 static UWord em_supplist_searches = 0;
 
@@ -112,6 +126,11 @@ static UWord em_supplist_searches = 0;
    searching. */
 static UWord em_supplist_cmps = 0;
 
+/* Stats: number of caller matches answered from, and added to, the
+   suppression match cache. */
+static UWord em_suppcache_hits   = 0;
+static UWord em_suppcache_misses = 0;
+
 /*------------------------------------------------------------*/
 /*--- Error type                                           ---*/
 /*------------------------------------------------------------*/
@@ -127,6 +146,9 @@ static UWord em_supplist_cmps = 0;
 */
 struct _Error {
    struct _Error* next;
+   struct _Error* prev;
+   // Next error in the same errtab chain.
+   struct _Error* hnext;
    // Unique tag.  This gives the error a unique identity (handle) by
    // which it can be referred to afterwords.  Currently only used for
    // XML printing.
@@ -313,6 +335,103 @@ static Bool eq_Error ( VgRes res, const Error* e1, const Error* e2 )
    }
 }
 
+/* Hash an error on what every resolution of eq_Error looks at: its kind
+   and the top two entries of its stack trace.  Errors that eq_Error
+   considers equal always have the same hash, whatever the VgRes. */
+static UWord hash_Error ( ErrorKind ekind, ExeContext* where )
+{
+   StackTrace ips   = VG_(get_ExeContext_StackTrace)(where);
+   Int        n_ips = VG_(get_ExeContext_n_ips)(where);
+   UWord      h     = (UWord)ekind;
+
+   h = (h << 7) ^ (h >> (8 * sizeof(UWord) - 7)) ^ ips[0];
+   if (n_ips > 1)
+      h = (h << 7) ^ (h >> (8 * sizeof(UWord) - 7)) ^ ips[1];
+   h ^= h >> 17;
+   return h;
+}
+
+static void errtab_resize ( UInt new_size )
+{
+   Error* p;
+   UInt   i;
+
+   em_errtab_resizes++;
+   if (errtab != NULL)
+      VG_(free)(errtab);
+   errtab = VG_(malloc)("errormgr.errtab", new_size * sizeof(Error*));
+   for (i = 0; i < new_size; i++)
+      errtab[i] = NULL;
+   errtab_size = new_size;
+
+   for (p = errors; p != NULL; p = p->next) {
+      i = hash_Error(p->ekind, p->where) & (errtab_size - 1);
+      p->hnext  = errtab[i];
+      errtab[i] = p;
+   }
+}
+
+/* Add a new error at the front of the error list and in errtab. */
+static void add_Error ( Error* err )
+{
+   UInt i;
+
+   if (errtab == NULL)
+      errtab_resize(ERRTAB_INIT_SIZE);
+
+   err->prev = NULL;
+   err->next = errors;
+   if (errors != NULL)
+      errors->prev = err;
+   errors = err;
+
+   i = hash_Error(err->ekind, err->where) & (errtab_size - 1);
+   err->hnext = errtab[i];
+   errtab[i]  = err;
+
+   errtab_used++;
+   if (errtab_used > 2 * errtab_size)
+      errtab_resize(2 * errtab_size);
+}
+
+/* Find an error matching err at resolution res.  A found error is moved
+   to the front of its chain, and of the error list, which is also what
+   VG_(show_last_error) relies on. */
+static Error* find_Error ( VgRes res, const Error* err )
+{
+   Error *p, *p_prev;
+   UInt   i;
+
+   em_errlist_searches++;
+   if (errtab == NULL)
+      return NULL;
+
+   i = hash_Error(err->ekind, err->where) & (errtab_size - 1);
+   for (p = errtab[i], p_prev = NULL; p != NULL; p_prev = p, p = p->hnext) {
+      em_errlist_cmps++;
+      if (eq_Error(res, p, err))
+         break;
+   }
+   if (p == NULL)
+      return NULL;
+
+   if (p_prev != NULL) {
+      p_prev->hnext = p->hnext;
+      p->hnext      = errtab[i];
+      errtab[i]     = p;
+   }
+   if (p->prev != NULL) {
+      p->prev->next = p->next;
+      if (p->next != NULL)
+         p->next->prev = p->prev;
+      p->prev       = NULL;
+      p->next       = errors;
+      errors->prev  = p;
+      errors        = p;
+   }
+   return p;
+}
+
 
 /* Helper functions for suppression generation: print a single line of
    a suppression pseudo-stack-trace, either in XML or text mode.  It's
@@ -648,6 +767,8 @@ void construct_error ( Error* err, ThreadId tid, ErrorKind ekind, Addr a,
    /* Core-only parts */
    err->unique   = unique_counter++;
    err->next     = NULL;
+   err->prev     = NULL;
+   err->hnext    = NULL;
    err->supp     = NULL;
    err->count    = 1;
    err->tid      = tid;
@@ -677,7 +798,6 @@ void VG_(maybe_record_error) ( ThreadId tid,
 {
           Error  err;
           Error* p;
-          Error* p_prev;
           UInt   extra_size;
           VgRes  exe_res          = Vg_MedRes;
    static Bool   stopping_message = False;
@@ -748,36 +868,17 @@ void VG_(maybe_record_error) ( ThreadId tid,
    construct_error ( &err, tid, ekind, a, s, extra, NULL );
 
    /* First, see if we've got an error record matching this one. */
-   em_errlist_searches++;
-   p       = errors;
-   p_prev  = NULL;
-   while (p != NULL) {
-      em_errlist_cmps++;
-      if (eq_Error(exe_res, p, &err)) {
-         /* Found it. */
-         p->count++;
-	 if (p->supp != NULL) {
-            /* Deal correctly with suppressed errors. */
-            p->supp->count++;
-            n_errs_suppressed++;	 
-         } else {
-            n_errs_found++;
-         }
-
-         /* Move p to the front of the list so that future searches
-            for it are faster. It also allows to print the last
-            error (see VG_(show_last_error). */
-         if (p_prev != NULL) {
-            vg_assert(p_prev->next == p);
-            p_prev->next = p->next;
-            p->next      = errors;
-            errors       = p;
-	 }
-
-         return;
+   p = find_Error(exe_res, &err);
+   if (p != NULL) {
+      p->count++;
+      if (p->supp != NULL) {
+         /* Deal correctly with suppressed errors. */
+         p->supp->count++;
+         n_errs_suppressed++;
+      } else {
+         n_errs_found++;
       }
-      p_prev = p;
-      p      = p->next;
+      return;
    }
 
    /* Didn't see it.  Copy and add. */
@@ -829,9 +930,8 @@ void VG_(maybe_record_error) ( ThreadId tid,
       p->extra = new_extra;
    }
 
-   p->next = errors;
    p->supp = is_suppressible_error(&err);
-   errors  = p;
+   add_Error(p);
    if (p->supp == NULL) {
       /* update stats */
       n_err_contexts++;
@@ -1903,6 +2003,56 @@ Bool supp_matches_error(const Supp* su, const Error* err)
    error?  If so, return a pointer to the Supp record, otherwise NULL.
    Tries to minimise the number of symbol searches since they are expensive.  
 */
+/* Cache of supp_matches_callers results, per (stack trace, suppression).
+   Matching the callers of a suppression means looking up function and
+   object names for the stack trace, which is by far the most expensive
+   part of is_suppressible_error.  ExeContexts are never freed, so their
+   address identifies a stack trace; but the names of its IPs change when
+   debug info is loaded or discarded, so the cache is flushed whenever
+   VG_(debuginfo_generation) moves on.
+
+   The cache is direct-mapped and of fixed size: a new result simply
+   replaces whatever was in its slot, so the cache does not grow with
+   the number of errors times the number of suppressions. */
+#define N_SUPPMATCH_CACHE 4093  /* prime */
+
+typedef
+   struct {
+      const ExeContext* where;   /* NULL if the slot is empty */
+      const Supp*       su;
+      Bool              matches;
+   }
+   SuppMatch;
+
+static SuppMatch suppmatch_cache[N_SUPPMATCH_CACHE];
+static UInt      suppmatch_cache_gen = 0;
+
+static Bool supp_matches_callers_cached ( IPtoFunOrObjCompleter* ip2fo,
+                                          const Supp* su,
+                                          const ExeContext* where )
+{
+   UWord      ix;
+   SuppMatch* m;
+
+   if (suppmatch_cache_gen != VG_(debuginfo_generation)()) {
+      VG_(memset)(suppmatch_cache, 0, sizeof(suppmatch_cache));
+      suppmatch_cache_gen = VG_(debuginfo_generation)();
+   }
+
+   ix = (((UWord)where >> 3) ^ ((UWord)su >> 3)) % N_SUPPMATCH_CACHE;
+   m  = &suppmatch_cache[ix];
+   if (m->where == where && m->su == su) {
+      em_suppcache_hits++;
+      return m->matches;
+   }
+
+   em_suppcache_misses++;
+   m->where   = where;
+   m->su      = su;
+   m->matches = supp_matches_callers(ip2fo, su);
+   return m->matches;
+}
+
 static Supp* is_suppressible_error ( const Error* err )
 {
    Supp* su;
@@ -1946,7 +2096,7 @@ static Supp* is_suppressible_error ( const Error* err )
    for (su = suppressions; su != NULL; su = su->next) {
       em_supplist_cmps++;
       if (supp_matches_error(su, err) 
-          && supp_matches_callers(&ip2fo, su)) {
+          && supp_matches_callers_cached(&ip2fo, su, err->where)) {
          /* got a match.  */
          /* Inform the tool that err is suppressed by su. */
          (void)VG_TDICT_CALL(tool_update_extra_suppression_use, err, su);
@@ -1975,10 +2125,18 @@ void VG_(print_errormgr_stats) ( void )
       " errormgr: %'lu supplist searches, %'lu comparisons during search\n",
       em_supplist_searches, em_supplist_cmps
    );
+   VG_(dmsg)(
+      " errormgr: %'lu suppcache hits, %'lu misses\n",
+      em_suppcache_hits, em_suppcache_misses
+   );
    VG_(dmsg)(
       " errormgr: %'lu errlist searches, %'lu comparisons during search\n",
       em_errlist_searches, em_errlist_cmps
    );
+   VG_(dmsg)(
+      " errormgr: %'u errors in %'u buckets, %'lu resizes\n",
+      errtab_used, errtab_size, em_errtab_resizes
+   );
 }
 
 /*--------------------------------------------------------------------*/
@@ -170,6 +170,7 @@ void VG_(print_all_stats) (Bool memory_stats, Bool tool_stats)
    VG_(print_translation_stats)();
    VG_(print_tt_tc_stats)();
    VG_(print_scheduler_stats)();
+   VG_(print_debuginfo_stats)();
    VG_(print_ExeContext_stats)( False /* with_stacktraces */ );
    VG_(print_errormgr_stats)();
    if (tool_stats && VG_(needs).print_stats) {
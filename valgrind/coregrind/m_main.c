@@ -160,10 +160,14 @@ static void usage_NORETURN ( Bool debug_help )
 "    --allow-mismatched-debuginfo=no|yes  [no]\n"
 "                              for the above two flags only, accept debuginfo\n"
 "                              objects that don't \"match\" the main object\n"
-"    --smc-check=none|stack|all|all-non-file [all-non-file]\n"
+"    --debuginfo-cache=<dir>   keep line number, inline and unwind info of\n"
+"                              objects with a build-id in <dir>, for reuse\n"
+"                              by later runs\n"
+"    --smc-check=none|stack|all|all-non-file|mprotect [all-non-file]\n"
 "                              checks for self-modifying code: none, only for\n"
 "                              code found in stacks, for all code, or for all\n"
-"                              code except that from file-backed mappings\n"
+"                              code except that from file-backed mappings;\n"
+"                              mprotect write-protects pages code is taken from\n"
 "    --read-inline-info=yes|no read debug info about inlined function calls\n"
 "                              and use it to do better stack traces.  [yes]\n"
 "                              on Linux/Android/Solaris for Memcheck/Helgrind/DRD\n"
@@ -172,6 +176,8 @@ static void usage_NORETURN ( Bool debug_help )
 "                              and use it to print better error messages in\n"
 "                              tools that make use of it (Memcheck, Helgrind,\n"
 "                              DRD) [no]\n"
+"    --lazy-debuginfo=no|yes   read line number, unwind and inline info for an\n"
+"                              object only when it is first needed [no]\n"
 "    --vgdb-poll=<number>      gdbserver poll max every <number> basic blocks [%d] \n"
 "    --vgdb-shadow-registers=no|yes   let gdb see the shadow registers [no]\n"
 "    --vgdb-prefix=<prefix>    prefix for vgdb FIFOs [%s]\n"
@@ -180,7 +186,10 @@ static void usage_NORETURN ( Bool debug_help )
 "         where hint is one of:\n"
 "           lax-ioctls lax-doors fuse-compatible enable-outer\n"
 "           no-inner-prefix no-nptl-pthread-stackcache none\n"
-"    --fair-sched=no|yes|try   schedule threads fairly on multicore systems [no]\n"
+"    --fair-sched=no|yes|try|handoff  schedule threads fairly on multicore\n"
+"                              systems ('handoff': low-latency queue lock) [no]\n"
+"    --adaptive-timeslice=no|yes  shorten timeslices while other threads\n"
+"                              are waiting to run [no]\n"
 "    --kernel-variant=variant1,variant2,...\n"
 "         handle non-standard kernel variants [none]\n"
 "         where variant is one of:\n"
@@ -188,6 +197,8 @@ static void usage_NORETURN ( Bool debug_help )
 "           android-gpu-sgx5xx android-gpu-adreno3xx none\n"
 "    --merge-recursive-frames=<number>  merge frames between identical\n"
 "           program counters in max <number> frames) [0]\n"
+"    --stack-trace-cache=no|yes  reuse the unchanged outer frames of a\n"
+"           thread's previous stack trace when unwinding its stack [no]\n"
 "    --num-transtab-sectors=<number> size of translated code cache [%d]\n"
 "           more sectors may increase performance, but use more memory.\n"
 "    --avg-transtab-entry-size=<number> avg size in bytes of a translated\n"
@@ -657,10 +668,14 @@ void main_process_cmd_line_options ( /*OUT*/Bool* logging_to_fd,
             VG_(clo_fair_sched) = try_fair_sched;
          else if (VG_(strcmp)(tmp_str, "no") == 0)
             VG_(clo_fair_sched) = disable_fair_sched;
+         else if (VG_(strcmp)(tmp_str, "handoff") == 0)
+            VG_(clo_fair_sched) = handoff_fair_sched;
          else
             VG_(fmsg_bad_option)(arg,
-               "Bad argument, should be 'yes', 'try' or 'no'\n");
+               "Bad argument, should be 'yes', 'try', 'handoff' or 'no'\n");
       }
+      else if VG_BOOL_CLO(arg, "--adaptive-timeslice",
+                            VG_(clo_adaptive_timeslice)) {}
       else if VG_BOOL_CLO(arg, "--trace-sched",      VG_(clo_trace_sched)) {}
       else if VG_BOOL_CLO(arg, "--trace-signals",    VG_(clo_trace_signals)) {}
       else if VG_BOOL_CLO(arg, "--trace-symtab",     VG_(clo_trace_symtab)) {}
@@ -678,6 +693,7 @@ void main_process_cmd_line_options ( /*OUT*/Bool* logging_to_fd,
       else if VG_BOOL_CLO(arg, "--wait-for-gdb",     VG_(clo_wait_for_gdb)) {}
       else if VG_BOOL_CLO(arg, "--sym-offsets",      VG_(clo_sym_offsets)) {}
       else if VG_BOOL_CLO(arg, "--read-inline-info", VG_(clo_read_inline_info)) {}
+      else if VG_BOOL_CLO(arg, "--lazy-debuginfo", VG_(clo_lazy_debuginfo)) {}
       else if VG_BOOL_CLO(arg, "--read-var-info",    VG_(clo_read_var_info)) {}
 
       else if VG_INT_CLO (arg, "--dump-error",       VG_(clo_dump_error))   {}
@@ -694,6 +710,8 @@ void main_process_cmd_line_options ( /*OUT*/Bool* logging_to_fd,
       else if VG_BINT_CLO(arg, "--merge-recursive-frames",
                                VG_(clo_merge_recursive_frames), 0,
                                VG_DEEPEST_BACKTRACE) {}
+      else if VG_BOOL_CLO(arg, "--stack-trace-cache",
+                               VG_(clo_stack_trace_cache)) {}
 
       else if VG_XACT_CLO(arg, "--smc-check=none", 
                           VG_(clo_smc_check), Vg_SmcNone) {}
@@ -703,6 +721,8 @@ void main_process_cmd_line_options ( /*OUT*/Bool* logging_to_fd,
                           VG_(clo_smc_check), Vg_SmcAll) {}
       else if VG_XACT_CLO(arg, "--smc-check=all-non-file",
                           VG_(clo_smc_check), Vg_SmcAllNonFile) {}
+      else if VG_XACT_CLO(arg, "--smc-check=mprotect",
+                          VG_(clo_smc_check), Vg_SmcMprotect) {}
 
       else if VG_USETX_CLO (arg, "--kernel-variant",
                             "bproc,"
@@ -801,6 +821,8 @@ void main_process_cmd_line_options ( /*OUT*/Bool* logging_to_fd,
 
       else if VG_STR_CLO (arg, "--extra-debuginfo-path",
                       VG_(clo_extra_debuginfo_path)) {}
+      else if VG_STR_CLO (arg, "--debuginfo-cache",
+                      VG_(clo_debuginfo_cache)) {}
 
       else if VG_STR_CLO(arg, "--require-text-symbol", tmp_str) {
          /* String needs to be of the form C?*C?*, where C is any
@@ -0,0 +1,261 @@
+/*--------------------------------------------------------------------*/
+/*--- Linux handoff lock implementation       handoff-lock-linux.c ---*/
+/*---                                                              ---*/
+/*--- FIFO queue lock in which each waiter spins, and if need be   ---*/
+/*--- sleeps, on its own futex.  Releasing the lock hands it over  ---*/
+/*--- directly to the next waiter and wakes up only that waiter.   ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   Copyright (C) 2015-2015 The Valgrind developers
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#include "pub_core_basics.h"
+#include "pub_core_libcassert.h"
+#include "pub_core_libcbase.h"     // VG_(memset)()
+#include "pub_core_libcprint.h"
+#include "pub_core_syscall.h"
+#include "pub_core_vki.h"
+#include "pub_core_vkiscnums.h"    // __NR_futex
+#include "pub_core_libcproc.h"
+#include "pub_core_mallocfree.h"
+#include "pub_core_threadstate.h"  // VG_N_THREADS
+#include "pub_core_inner.h"
+#if defined(ENABLE_INNER_CLIENT_REQUEST)
+#include "helgrind/helgrind.h"
+#endif
+#include "priv_sched-lock.h"
+#include "priv_sched-lock-impl.h"
+
+/*
+ * This is an array based queue lock (T. E. Anderson, "The performance of
+ * spin lock alternatives for shared-memory multiprocessors", IEEE TPDS,
+ * 1990), which has the same local-spinning property as an MCS lock but
+ * does not need a per-thread queue node.  Each ticket maps onto its own
+ * slot, and there are more slots than threads, so no two waiters ever
+ * share a slot.
+ *
+ * A waiter first spins on its slot for a while, since the lock is often
+ * handed over within a few microseconds, and only then sleeps on the
+ * slot's futex.  The spin limit adapts: it grows when spinning succeeds
+ * and shrinks when the waiter had to sleep anyway, so that a lock which
+ * is held for whole timeslices does not burn CPU time.
+ *
+ * Compared to the ticket lock, a release wakes up exactly one thread, and
+ * only if that thread actually went to sleep.
+ */
+
+/* Slot states. */
+#define HL_WAITING  0
+#define HL_SLEEPING 1
+#define HL_GRANTED  2
+
+#define HL_SPIN_MIN  32
+#define HL_SPIN_MAX  16384
+#define HL_SPIN_INIT 1024
+
+struct hl_slot {
+   volatile UInt state;
+   /* Keep each slot on its own cache line. */
+   UInt pad[15];
+};
+
+struct sched_lock {
+   volatile UInt tail;
+   UInt owner_ticket;
+   UInt mask;
+   volatile UInt spin_limit;
+   int owner;
+   struct hl_slot *slot;
+};
+
+static Bool s_debug;
+
+static __inline__ void cpu_relax(void)
+{
+#if defined(VGA_x86) || defined(VGA_amd64)
+   __asm__ __volatile__("pause" : : : "memory");
+#else
+   __asm__ __volatile__("" : : : "memory");
+#endif
+}
+
+static const HChar *get_sched_lock_name(void)
+{
+   return "handoff lock";
+}
+
+static struct sched_lock *create_sched_lock(void)
+{
+   struct sched_lock *p;
+   UInt n_slots;
+
+   // One slot more than the number of threads, rounded up to a power of
+   // two so that a ticket can be mapped onto its slot with a mask.
+   for (n_slots = 2; n_slots < VG_N_THREADS + 1; n_slots <<= 1)
+      ;
+
+   p = VG_(malloc)("sched_lock", sizeof(*p));
+   VG_(memset)(p, 0, sizeof(*p));
+   p->slot = VG_(malloc)("sched_lock.slot", n_slots * sizeof(p->slot[0]));
+   VG_(memset)(p->slot, 0, n_slots * sizeof(p->slot[0]));
+
+   // The futex syscall requires that a futex takes four bytes.
+   vg_assert(sizeof(p->slot[0].state) == 4);
+
+   p->mask       = n_slots - 1;
+   p->spin_limit = HL_SPIN_INIT;
+   p->slot[0].state = HL_GRANTED;
+
+   INNER_REQUEST(ANNOTATE_RWLOCK_CREATE(p));
+   INNER_REQUEST(ANNOTATE_BENIGN_RACE_SIZED(&p->spin_limit,
+                                            sizeof(p->spin_limit), ""));
+   INNER_REQUEST(ANNOTATE_BENIGN_RACE_SIZED(p->slot,
+                                            n_slots * sizeof(p->slot[0]), ""));
+   return p;
+}
+
+static void destroy_sched_lock(struct sched_lock *p)
+{
+   INNER_REQUEST(ANNOTATE_RWLOCK_DESTROY(p));
+   VG_(free)(p->slot);
+   VG_(free)(p);
+}
+
+static int get_sched_lock_owner(struct sched_lock *p)
+{
+   return p->owner;
+}
+
+static int get_sched_lock_waiters(struct sched_lock *p)
+{
+   /* Racy, but only used as a hint. */
+   return p->owner ? (int)(p->tail - p->owner_ticket - 1) : 0;
+}
+
+/*
+ * Take a ticket, then wait until the previous owner has set the slot of
+ * that ticket to HL_GRANTED.  A waiter that gives up spinning announces that
+ * it is about to sleep by moving its slot from HL_WAITING to HL_SLEEPING, so
+ * that the releasing thread knows a wakeup is needed.
+ */
+static void acquire_sched_lock(struct sched_lock *p)
+{
+   UInt ticket, limit, i;
+   volatile UInt *state;
+   SysRes sres;
+
+   ticket = __sync_fetch_and_add(&p->tail, 1);
+   state = &p->slot[ticket & p->mask].state;
+   if (s_debug)
+      VG_(printf)("[%d/%d] acquire: ticket %u\n", VG_(getpid)(),
+                  VG_(gettid)(), ticket);
+
+   limit = p->spin_limit;
+   for (i = 0; i < limit && *state != HL_GRANTED; i++)
+      cpu_relax();
+
+   if (*state == HL_GRANTED) {
+      /* Aim for about twice the spin time that was needed this time. */
+      if (i > 0) {
+         limit += ((Int)(2 * i + HL_SPIN_MIN) - (Int)limit) / 8;
+         p->spin_limit = limit > HL_SPIN_MAX ? HL_SPIN_MAX : limit;
+      }
+   } else {
+      limit -= limit / 4;
+      p->spin_limit = limit < HL_SPIN_MIN ? HL_SPIN_MIN : limit;
+      while (*state != HL_GRANTED) {
+         if (*state == HL_WAITING
+             && !__sync_bool_compare_and_swap(state, HL_WAITING,
+                                              HL_SLEEPING))
+            continue;
+         if (s_debug)
+            VG_(printf)("[%d/%d] acquire: ticket %u - sleeping\n",
+                        VG_(getpid)(), VG_(gettid)(), ticket);
+         sres = VG_(do_syscall3)(__NR_futex, (UWord)state,
+                                 VKI_FUTEX_WAIT | VKI_FUTEX_PRIVATE_FLAG,
+                                 HL_SLEEPING);
+         if (sr_isError(sres) && sr_Err(sres) != VKI_EAGAIN
+             && sr_Err(sres) != VKI_EINTR) {
+            VG_(printf)("futex_wait() returned error code %lu\n",
+                        sr_Err(sres));
+            vg_assert(False);
+         }
+      }
+   }
+   __sync_synchronize();
+
+   /* Nobody else can use this slot until 'mask + 1' more tickets have been
+      handed out, which cannot happen before this thread releases the
+      lock. */
+   *state = HL_WAITING;
+   INNER_REQUEST(ANNOTATE_RWLOCK_ACQUIRED(p, /*is_w*/1));
+   vg_assert(p->owner == 0);
+   p->owner = VG_(gettid)();
+   p->owner_ticket = ticket;
+}
+
+/*
+ * Hand the lock over to the holder of the next ticket, whether or not that
+ * ticket has been taken yet.  Only issue a wakeup if the new owner has gone
+ * to sleep.
+ */
+static void release_sched_lock(struct sched_lock *p)
+{
+   UInt next, prev;
+   volatile UInt *state;
+   SysRes sres;
+
+   vg_assert(p->owner != 0);
+   p->owner = 0;
+   INNER_REQUEST(ANNOTATE_RWLOCK_RELEASED(p, /*is_w*/1));
+   next = p->owner_ticket + 1;
+   state = &p->slot[next & p->mask].state;
+   do {
+      prev = *state;
+   } while (!__sync_bool_compare_and_swap(state, prev, HL_GRANTED));
+   vg_assert(prev != HL_GRANTED);
+
+   if (prev == HL_SLEEPING) {
+      if (s_debug)
+         VG_(printf)("[%d/%d] release: waking up ticket %u\n",
+                     VG_(getpid)(), VG_(gettid)(), next);
+      sres = VG_(do_syscall3)(__NR_futex, (UWord)state,
+                              VKI_FUTEX_WAKE | VKI_FUTEX_PRIVATE_FLAG, 1);
+      vg_assert(!sr_isError(sres));
+   } else {
+      if (s_debug)
+         VG_(printf)("[%d/%d] release: ticket %u is not sleeping\n",
+                     VG_(getpid)(), VG_(gettid)(), next);
+   }
+}
+
+const struct sched_lock_ops ML_(linux_handoff_lock_ops) = {
+   .get_sched_lock_name    = get_sched_lock_name,
+   .create_sched_lock      = create_sched_lock,
+   .destroy_sched_lock     = destroy_sched_lock,
+   .get_sched_lock_owner   = get_sched_lock_owner,
+   .get_sched_lock_waiters = get_sched_lock_waiters,
+   .acquire_sched_lock     = acquire_sched_lock,
+   .release_sched_lock     = release_sched_lock,
+};
@@ -42,6 +42,7 @@ static struct sched_lock_ops const *const sched_lock_impl[] = {
    [sched_lock_generic] = &ML_(generic_sched_lock_ops),
 #ifdef ENABLE_LINUX_TICKET_LOCK
    [sched_lock_ticket]  = &ML_(linux_ticket_lock_ops),
+   [sched_lock_handoff] = &ML_(linux_handoff_lock_ops),
 #endif
 };
 
@@ -85,6 +86,26 @@ int ML_(get_sched_lock_owner)(struct sched_lock *p)
    return (sched_lock_ops->get_sched_lock_owner)(p);
 }
 
+/**
+ * Whether the current implementation can report the number of waiters.
+ */
+Bool ML_(sched_lock_counts_waiters)(void)
+{
+   return sched_lock_ops->get_sched_lock_waiters != NULL;
+}
+
+/**
+ * Number of threads waiting to acquire the lock.  This is a hint only: the
+ * value can be out of date by the time it is used.  Returns 0 if the
+ * current implementation does not count waiters.
+ */
+int ML_(get_sched_lock_waiters)(struct sched_lock *p)
+{
+   if (sched_lock_ops->get_sched_lock_waiters == NULL)
+      return 0;
+   return (sched_lock_ops->get_sched_lock_waiters)(p);
+}
+
 void ML_(acquire_sched_lock)(struct sched_lock *p)
 {
    return (sched_lock_ops->acquire_sched_lock)(p);
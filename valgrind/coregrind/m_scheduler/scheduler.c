@@ -108,6 +108,12 @@
    give finer interleaving but much increased scheduling overheads. */
 #define SCHEDULING_QUANTUM   100000
 
+/* With --adaptive-timeslice=yes, the timeslice is halved each time a
+   thread finds other threads waiting for the_BigLock at the end of its
+   slice, down to this many blocks, and doubled again (up to
+   SCHEDULING_QUANTUM) when nobody is waiting. */
+#define MIN_SCHEDULING_QUANTUM 1000
+
 /* If False, a fault is Valgrind-internal (ie, a bug) */
 Bool VG_(in_generated_code) = False;
 
@@ -129,6 +135,7 @@ static void mostly_clear_thread_record ( ThreadId tid );
 /* Stats. */
 static ULong n_scheduling_events_MINOR = 0;
 static ULong n_scheduling_events_MAJOR = 0;
+static ULong n_timeslices_contended = 0;
 
 /* Stats: number of XIndirs, and number that missed in the fast
    cache. */
@@ -157,6 +164,10 @@ void VG_(print_scheduler_stats)(void)
    VG_(message)(Vg_DebugMsg,
       "scheduler: %'llu/%'llu major/minor sched events.\n",
       n_scheduling_events_MAJOR, n_scheduling_events_MINOR);
+   if (VG_(clo_adaptive_timeslice))
+      VG_(message)(Vg_DebugMsg,
+         "scheduler: %'llu major sched events found waiting threads.\n",
+         n_timeslices_contended);
    VG_(message)(Vg_DebugMsg, 
                 "   sanity: %u cheap, %u expensive checks.\n",
                 sanity_fast_count, sanity_slow_count );
@@ -608,7 +619,14 @@ ThreadId VG_(scheduler_init_phase1) ( void )
 
    VG_(debugLog)(1,"sched","sched_init_phase1\n");
 
-   if (VG_(clo_fair_sched) != disable_fair_sched
+   if (VG_(clo_fair_sched) == handoff_fair_sched) {
+      if (!ML_(set_sched_lock_impl)(sched_lock_handoff)) {
+         VG_(printf)("Error: handoff scheduling is not supported"
+                     " on this system.\n");
+         VG_(exit)(1);
+      }
+   }
+   else if (VG_(clo_fair_sched) != disable_fair_sched
        && !ML_(set_sched_lock_impl)(sched_lock_ticket)
        && VG_(clo_fair_sched) == enable_fair_sched)
    {
@@ -616,6 +634,13 @@ ThreadId VG_(scheduler_init_phase1) ( void )
       VG_(exit)(1);
    }
 
+   if (VG_(clo_adaptive_timeslice) && !ML_(sched_lock_counts_waiters)()) {
+      VG_(umsg)("Warning: --adaptive-timeslice=yes has no effect with the"
+                " %s scheduler lock;\n", ML_(get_sched_lock_name)());
+      VG_(umsg)("use --fair-sched=yes or --fair-sched=handoff.\n");
+      VG_(clo_adaptive_timeslice) = False;
+   }
+
    if (VG_(clo_verbosity) > 1) {
       VG_(message)(Vg_DebugMsg,
                    "Scheduler: using %s scheduler lock implementation.\n",
@@ -841,6 +866,22 @@ void VG_(force_vgdb_poll) ( void )
    vgdb_next_poll = VGDB_POLL_ASAP;
 }
 
+/* Events taken away from the running thread by
+   VG_(stop_generated_code_soon), which it has not actually done.
+   Reset at the start of each run of generated code. */
+static Int n_events_cut = 0;
+
+void VG_(stop_generated_code_soon) ( ThreadId tid )
+{
+   ThreadState* tst = VG_(get_ThreadState)(tid);
+
+   vg_assert(VG_(in_generated_code));
+   if ((Int)tst->arch.vex.host_EvC_COUNTER > 0) {
+      n_events_cut += (Int)tst->arch.vex.host_EvC_COUNTER;
+      tst->arch.vex.host_EvC_COUNTER = 0;
+   }
+}
+
 /* Run the thread tid for a while, and return a VG_TRC_* value
    indicating why VG_(disp_run_translations) stopped, and possibly an
    auxiliary word.  Also, only allow the thread to run for at most
@@ -877,6 +918,12 @@ void run_thread_for_a_while ( /*OUT*/HWord* two_words,
    do_pre_run_checks( tst );
    /* end Paranoia */
 
+   /* With --smc-check=mprotect, get rid of the translations of pages
+      which have been written to since generated code last ran, before
+      looking any up. */
+   if (VG_(clo_smc_check) == Vg_SmcMprotect)
+      VG_(smc_discard_pending)();
+
    /* Futz with the XIndir stats counters. */
    vg_assert(VG_(stats__n_xindirs_32) == 0);
    vg_assert(VG_(stats__n_xindir_misses_32) == 0);
@@ -921,6 +968,7 @@ void run_thread_for_a_while ( /*OUT*/HWord* two_words,
    //vg_assert(VG_(threads)[tid].siginfo.si_signo == 0);
 
    /* Set up event counter stuff for the run. */
+   n_events_cut = 0;
    tst->arch.vex.host_EvC_COUNTER = *dispatchCtrP;
    tst->arch.vex.host_EvC_FAILADDR
       = (HWord)VG_(fnptr_to_fnentry)( &VG_(disp_cp_evcheck_fail) );
@@ -996,6 +1044,7 @@ void run_thread_for_a_while ( /*OUT*/HWord* two_words,
            is seriously wrong. */
         vg_assert(dispatchCtrAfterwards >= 0);
      }
+     done_this_time -= n_events_cut;
    }
 
    vg_assert(done_this_time >= 0);
@@ -1189,6 +1238,8 @@ VgSchedReturnCode VG_(scheduler) ( ThreadId tid )
 {
    /* Holds the remaining size of this thread's "timeslice". */
    Int dispatch_ctr = 0;
+   /* Size of this thread's next timeslice. */
+   Int quantum = SCHEDULING_QUANTUM;
 
    ThreadState *tst = VG_(get_ThreadState)(tid);
    static Bool vgdb_startup_action_done = False;
@@ -1317,8 +1368,22 @@ VgSchedReturnCode VG_(scheduler) ( ThreadId tid )
 	 /* For stats purposes only. */
 	 n_scheduling_events_MAJOR++;
 
-	 /* Figure out how many bbs to ask vg_run_innerloop to do. */
-         dispatch_ctr = SCHEDULING_QUANTUM;
+	 /* Figure out how many bbs to ask vg_run_innerloop to do.  If
+	    other threads queued up for the lock while we had it, give
+	    them a chance sooner next time. */
+         if (VG_(clo_adaptive_timeslice)) {
+            if (ML_(get_sched_lock_waiters)(the_BigLock) > 0) {
+               n_timeslices_contended++;
+               quantum /= 2;
+               if (quantum < MIN_SCHEDULING_QUANTUM)
+                  quantum = MIN_SCHEDULING_QUANTUM;
+            } else {
+               quantum *= 2;
+               if (quantum > SCHEDULING_QUANTUM)
+                  quantum = SCHEDULING_QUANTUM;
+            }
+         }
+         dispatch_ctr = quantum;
 
 	 /* paranoia ... */
 	 vg_assert(tst->tid == tid);
@@ -1450,8 +1515,10 @@ VgSchedReturnCode VG_(scheduler) ( ThreadId tid )
 	 break;
 
       case VG_TRC_INNER_COUNTERZERO:
-	 /* Timeslice is out.  Let a new thread be scheduled. */
-	 vg_assert(dispatch_ctr == 0);
+	 /* Timeslice is out.  Let a new thread be scheduled.  Or else
+	    VG_(stop_generated_code_soon) cut the run short, and the
+	    thread carries on with the rest of its timeslice. */
+	 vg_assert(dispatch_ctr == 0 || n_events_cut > 0);
 	 break;
 
       case VG_TRC_FAULT_SIGNAL:
@@ -100,6 +100,12 @@ static int get_sched_lock_owner(struct sched_lock *p)
    return p->owner;
 }
 
+static int get_sched_lock_waiters(struct sched_lock *p)
+{
+   /* Racy, but only used as a hint. */
+   return p->owner ? (int)(p->tail - p->head - 1) : 0;
+}
+
 /*
  * Acquire ticket lock. Increment the tail of the queue and use the original
  * value as the ticket value. Wait until the head of the queue equals the
@@ -184,10 +190,11 @@ static void release_sched_lock(struct sched_lock *p)
 }
 
 const struct sched_lock_ops ML_(linux_ticket_lock_ops) = {
-   .get_sched_lock_name  = get_sched_lock_name,
-   .create_sched_lock    = create_sched_lock,
-   .destroy_sched_lock   = destroy_sched_lock,
-   .get_sched_lock_owner = get_sched_lock_owner,
-   .acquire_sched_lock   = acquire_sched_lock,
-   .release_sched_lock   = release_sched_lock,
+   .get_sched_lock_name    = get_sched_lock_name,
+   .create_sched_lock      = create_sched_lock,
+   .destroy_sched_lock     = destroy_sched_lock,
+   .get_sched_lock_owner   = get_sched_lock_owner,
+   .get_sched_lock_waiters = get_sched_lock_waiters,
+   .acquire_sched_lock     = acquire_sched_lock,
+   .release_sched_lock     = release_sched_lock,
 };
@@ -225,6 +225,7 @@
 #include "pub_core_syscall.h"
 #include "pub_core_syswrap.h"
 #include "pub_core_tooliface.h"
+#include "pub_core_transtab.h"      // For VG_(smc_handle_write_fault)()
 #include "pub_core_coredump.h"
 
 
@@ -2700,6 +2701,31 @@ static Bool extend_stack_if_appropriate(ThreadId tid, vki_siginfo_t* info)
    }
 }
 
+/* Returns True if the sync signal was due to a write to a page which
+   was write-protected for --smc-check=mprotect, in which case the
+   page is writable again.  Its translations are not discarded here,
+   but when the thread is back in the scheduler; the end of the current
+   block is the soonest that can be, so make it the latest too.
+*/
+static Bool unprotect_smc_page_if_appropriate(ThreadId tid,
+                                              vki_siginfo_t* info)
+{
+   if (VG_(clo_smc_check) != Vg_SmcMprotect
+       || info->si_signo != VKI_SIGSEGV
+       || info->si_code != VKI_SEGV_ACCERR)
+      return False;
+
+   if (!VG_(smc_handle_write_fault)((Addr)info->VKI_SIGINFO_si_addr))
+      return False;
+   if (VG_(in_generated_code))
+      VG_(stop_generated_code_soon)(tid);
+
+   if (VG_(clo_trace_signals))
+      VG_(dmsg)("       -> unprotected code page %#lx\n",
+                VG_PGROUNDDN((Addr)info->VKI_SIGINFO_si_addr));
+   return True;
+}
+
 static
 void sync_signalhandler_from_kernel ( ThreadId tid,
          Int sigNo, vki_siginfo_t *info, struct vki_ucontext *uc )
@@ -2716,7 +2742,11 @@ void sync_signalhandler_from_kernel ( ThreadId tid,
          so carry on panicking. */
    }
 
-   if (extend_stack_if_appropriate(tid, info)) {
+   if (unprotect_smc_page_if_appropriate(tid, info)) {
+      /* The write can now proceed; restart the instruction, as for
+         stack extension below.  This may also be a write by Valgrind
+         itself to client memory. */
+   } else if (extend_stack_if_appropriate(tid, info)) {
       /* Stack extension occurred, so we don't need to do anything else; upon
          returning from this function, we'll restart the host (hence guest)
          instruction. */
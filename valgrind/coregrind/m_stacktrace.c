@@ -37,6 +37,8 @@
 #include "pub_core_libcassert.h"
 #include "pub_core_libcprint.h"
 #include "pub_core_machine.h"
+#include "pub_core_mallocfree.h"
+#include "pub_core_execontext.h"    // VG_DEEPEST_BACKTRACE
 #include "pub_core_options.h"
 #include "pub_core_stacks.h"        // VG_(stack_limits)
 #include "pub_core_stacktrace.h"
@@ -485,6 +487,125 @@ UInt VG_(get_StackTrace_wrk) ( ThreadId tid_if_known,
 #if defined(VGP_amd64_linux) || defined(VGP_amd64_darwin) \
     || defined(VGP_amd64_solaris)
 
+/* With --stack-trace-cache=yes, each thread remembers the last stack
+   trace taken of it.  Consecutive traces of a thread usually share
+   their outer frames: think of a loop calling malloc.  So, once
+   unwinding finds a frame with the same (ip, sp, fp) as a frame of
+   the remembered trace, the frames after that one are copied rather
+   than unwound again, provided that the return address of each of
+   them is still in the stack slot just below its sp, which is where
+   the unwinder found it.  A change of the debug info or of the stack
+   limits throws the remembered trace away.  Recursive frame merging
+   is not compatible with this, and disables it. */
+
+typedef
+   struct {
+      UInt  gen;       /* VG_(debuginfo_generation)() when taken */
+      Addr  fp_max;    /* the fp_max the trace was taken with */
+      UInt  n_ips;     /* number of frames, 0 if there is no trace */
+      Bool  complete;  /* unwinding ended before max_n_ips was reached */
+      UInt  cursor;    /* where the search for a matching frame resumes */
+      Addr  ips[VG_DEEPEST_BACKTRACE];
+      Addr  sps[VG_DEEPEST_BACKTRACE];
+      Addr  fps[VG_DEEPEST_BACKTRACE];
+      /* Used for sps/fps when the caller does not want them. */
+      Addr  tmp_sps[VG_DEEPEST_BACKTRACE];
+      Addr  tmp_fps[VG_DEEPEST_BACKTRACE];
+   }
+   StackMemo;
+
+static StackMemo** stack_memo = NULL; /* indexed by ThreadId */
+
+/* Return the remembered trace of TID, ready for a new unwind, or NULL
+   if none can be used. */
+static StackMemo* get_stack_memo ( ThreadId tid, UInt max_n_ips,
+                                   Addr fp_max )
+{
+   StackMemo* m;
+
+   if (!VG_(clo_stack_trace_cache)
+       || VG_(clo_merge_recursive_frames) > 0
+       || tid == VG_INVALID_THREADID || tid >= VG_N_THREADS
+       || max_n_ips > VG_DEEPEST_BACKTRACE)
+      return NULL;
+
+   if (stack_memo == NULL)
+      stack_memo = VG_(calloc)("stacktrace.gsm.1",
+                               VG_N_THREADS, sizeof(StackMemo*));
+   m = stack_memo[tid];
+   if (m == NULL) {
+      m = VG_(malloc)("stacktrace.gsm.2", sizeof(StackMemo));
+      m->n_ips = 0;
+      stack_memo[tid] = m;
+   }
+   if (m->n_ips > 0
+       && (m->gen != VG_(debuginfo_generation)() || m->fp_max != fp_max))
+      m->n_ips = 0;
+   m->gen = VG_(debuginfo_generation)();
+   m->fp_max = fp_max;
+   m->cursor = 0;
+   return m;
+}
+
+/* Frame *PI-1 of the trace being taken has just been found.  If it is
+   also in the remembered trace, and the frames after it look unchanged,
+   append those to IPS/SPS/FPS, update *PI and return True. */
+static Bool stack_memo_reuse ( StackMemo* m,
+                               Addr* ips, Addr* sps, Addr* fps,
+                               /*MOD*/Int* pi, UInt max_n_ips,
+                               Addr fp_min, Addr fp_max )
+{
+   UInt i = *pi, j, k, n;
+   Addr slot;
+
+   while (m->cursor < m->n_ips && m->sps[m->cursor] < sps[i-1])
+      m->cursor++;
+   j = m->cursor;
+   if (j >= m->n_ips
+       || m->sps[j] != sps[i-1]
+       || m->ips[j] != ips[i-1]
+       || m->fps[j] != fps[i-1])
+      return False;
+
+   n = m->n_ips - (j+1);
+   if (i + n >= max_n_ips)
+      n = max_n_ips - i;
+   else if (!m->complete)
+      return False; /* unwinding might go further this time */
+
+   for (k = j+1; k < j+1+n; k++) {
+      slot = m->sps[k] - sizeof(Addr);
+      if (slot < fp_min || slot > fp_max)
+         return False;
+      if (*(Addr*)slot != m->ips[k] + 1)
+         return False;
+   }
+
+   VG_(memcpy)(&ips[i], &m->ips[j+1], n * sizeof(Addr));
+   VG_(memcpy)(&sps[i], &m->sps[j+1], n * sizeof(Addr));
+   VG_(memcpy)(&fps[i], &m->fps[j+1], n * sizeof(Addr));
+   *pi = i + n;
+   return True;
+}
+
+/* Remember the N_IPS frame trace just taken. */
+static void stack_memo_record ( StackMemo* m,
+                                const Addr* ips, const Addr* sps,
+                                const Addr* fps, UInt n_ips,
+                                UInt max_n_ips )
+{
+   /* Debug info read during the unwind may have made it inconsistent. */
+   if (m->gen != VG_(debuginfo_generation)()) {
+      m->n_ips = 0;
+      return;
+   }
+   VG_(memcpy)(m->ips, ips, n_ips * sizeof(Addr));
+   VG_(memcpy)(m->sps, sps, n_ips * sizeof(Addr));
+   VG_(memcpy)(m->fps, fps, n_ips * sizeof(Addr));
+   m->n_ips = n_ips;
+   m->complete = n_ips < max_n_ips;
+}
+
 UInt VG_(get_StackTrace_wrk) ( ThreadId tid_if_known,
                                /*OUT*/Addr* ips, UInt max_n_ips,
                                /*OUT*/Addr* sps, /*OUT*/Addr* fps,
@@ -496,6 +617,7 @@ UInt VG_(get_StackTrace_wrk) ( ThreadId tid_if_known,
    Addr  fp_max;
    UInt  n_found = 0;
    const Int cmrf = VG_(clo_merge_recursive_frames);
+   StackMemo* memo;
 
    vg_assert(sizeof(Addr) == sizeof(UWord));
    vg_assert(sizeof(Addr) == sizeof(void*));
@@ -548,6 +670,12 @@ UInt VG_(get_StackTrace_wrk) ( ThreadId tid_if_known,
    } 
 #  endif
 
+   memo = get_stack_memo(tid_if_known, max_n_ips, fp_max);
+   if (memo) {
+      if (!sps) sps = memo->tmp_sps;
+      if (!fps) fps = memo->tmp_fps;
+   }
+
    /* fp is %rbp.  sp is %rsp.  ip is %rip. */
 
    ips[0] = uregs.xip;
@@ -595,6 +723,11 @@ UInt VG_(get_StackTrace_wrk) ( ThreadId tid_if_known,
       if (i >= max_n_ips)
          break;
 
+      /* The rest of the stack may be as it was last time. */
+      if (memo && stack_memo_reuse(memo, ips, sps, fps, &i, max_n_ips,
+                                   fp_min, fp_max))
+         break;
+
       /* Try to derive a new (ip,sp,fp) triple from the current set. */
 
       /* First off, see if there is any CFI info to hand which can
@@ -677,6 +810,8 @@ UInt VG_(get_StackTrace_wrk) ( ThreadId tid_if_known,
    }
 
    n_found = i;
+   if (memo)
+      stack_memo_record(memo, ips, sps, fps, n_found, max_n_ips);
    return n_found;
 }
 
@@ -36,6 +36,7 @@
 
 /* requires #include "pub_core_options.h" */
 /* requires #include "pub_core_signals.h" */
+/* requires #include "pub_core_transtab.h" */
 
 /* This header defines types and macros which are useful for writing
    syscall wrappers.  It does not give prototypes for any such
@@ -621,8 +622,24 @@ static inline UWord getERR ( SyscallStatus* st ) {
 #define PRE_MEM_RASCIIZ(zzname, zzaddr) \
    VG_TRACK( pre_mem_read_asciiz, Vg_CoreSysCall, tid, zzname, zzaddr)
 
+/* With --smc-check=mprotect, pages the kernel is about to write must
+   not be write-protected, as the syscall would fail with EFAULT.  They
+   stay unprotected until VG_(post_syscall). */
 #define PRE_MEM_WRITE(zzname, zzaddr, zzlen) \
-   VG_TRACK( pre_mem_write, Vg_CoreSysCall, tid, zzname, zzaddr, zzlen)
+   do { \
+      if (VG_(clo_smc_check) == Vg_SmcMprotect) \
+         VG_(smc_prepare_kernel_write)(tid, zzaddr, zzlen); \
+      VG_TRACK( pre_mem_write, Vg_CoreSysCall, tid, zzname, zzaddr, zzlen); \
+   } while (0)
+
+/* For memory which the kernel may write to but which the wrapper only
+   describes afterwards, with POST_MEM_WRITE: with --smc-check=mprotect,
+   make sure the kernel can write there, without telling the tool. */
+#define PRE_MEM_KERNEL_WRITE(zzaddr, zzlen) \
+   do { \
+      if (VG_(clo_smc_check) == Vg_SmcMprotect) \
+         VG_(smc_prepare_kernel_write)(tid, zzaddr, zzlen); \
+   } while (0)
 
 #define POST_MEM_WRITE(zzaddr, zzlen) \
    VG_TRACK( post_mem_write, Vg_CoreSysCall, tid, zzaddr, zzlen)
@@ -268,6 +268,19 @@ ML_(notify_core_and_tool_of_mprotect) ( Addr a, SizeT len, Int prot )
 
 
 #if HAVE_MREMAP
+/* With --smc-check=mprotect, some pages of SEG may be write-protected
+   behind the client's back.  The kernel moves pages with their
+   protection unchanged, and by the time the translations are
+   discarded the old range is gone, so any such protection would stay
+   on the new range.  Hence discard the translations from the old
+   range, which makes its pages writable again, before moving it. */
+static void unprotect_before_remap ( NSegment const* seg,
+                                     Addr old_addr, SizeT old_len )
+{
+   if (VG_(clo_smc_check) == Vg_SmcMprotect && seg->hasT)
+      VG_(discard_translations)( old_addr, old_len, "do_remap(0)" );
+}
+
 /* Expand (or shrink) an existing mapping, potentially moving it at
    the same time (controlled by the MREMAP_MAYMOVE flag).  Nightmare.
 */
@@ -400,6 +413,7 @@ SysRes do_mremap( Addr old_addr, SizeT old_len,
       advised = VG_(am_get_advisory_client_simple)(new_addr, new_len, &ok);
       if (!ok || advised != new_addr)
          goto eNOMEM;
+      unprotect_before_remap( old_seg, old_addr, old_len );
       ok = VG_(am_relocate_nooverlap_client)
               ( &d, old_addr, old_len, new_addr, new_len );
       if (ok) {
@@ -456,6 +470,7 @@ SysRes do_mremap( Addr old_addr, SizeT old_len,
       /* assert new area does not overlap old */
       vg_assert(advised+new_len-1 < old_addr 
                 || advised > old_addr+old_len-1);
+      unprotect_before_remap( old_seg, old_addr, old_len );
       ok = VG_(am_relocate_nooverlap_client)
               ( &d, old_addr, old_len, advised, new_len );
       if (ok) {
@@ -1221,6 +1221,24 @@ PRE(sys_futex)
       SET_STATUS_Failure( VKI_ENOSYS );   // some futex function we don't understand
       break;
    }
+
+   /* The PI operations store the owner's tid in the futex word, and
+      FUTEX_WAKE_OP and the requeue-to-PI operations write the second
+      one. */
+   switch(ARG2 & ~(VKI_FUTEX_PRIVATE_FLAG|VKI_FUTEX_CLOCK_REALTIME)) {
+   case VKI_FUTEX_LOCK_PI:
+   case VKI_FUTEX_TRYLOCK_PI:
+   case VKI_FUTEX_UNLOCK_PI:
+      PRE_MEM_KERNEL_WRITE( ARG1, sizeof(Int) );
+      break;
+   case VKI_FUTEX_WAKE_OP:
+   case VKI_FUTEX_CMP_REQUEUE_PI:
+   case VKI_FUTEX_WAIT_REQUEUE_PI:
+      PRE_MEM_KERNEL_WRITE( ARG5, sizeof(Int) );
+      break;
+   default:
+      break;
+   }
 }
 POST(sys_futex)
 {
@@ -5571,6 +5589,10 @@ PRE(sys_ioctl)
       break;
    }
 
+   // Not all of the requests below which return data describe it with
+   // PRE_MEM_WRITE, but it is always at ARG3.
+   PRE_MEM_KERNEL_WRITE(ARG3, 1);
+
    // We now handle those that do look at ARG3 (and unknown ones fall into
    // this category).  Nb: some of these may well belong in the
    // doesn't-use-ARG3 switch above.
@@ -50,6 +50,7 @@
 #include "pub_core_machine.h"
 #include "pub_core_mallocfree.h"
 #include "pub_core_syswrap.h"
+#include "pub_core_transtab.h"      // For VG_(smc_*)
 
 #include "priv_types_n_macros.h"
 #include "priv_syswrap-main.h"
@@ -1728,6 +1729,12 @@ void VG_(client_syscall) ( ThreadId tid, UInt trc )
 
    tst = VG_(get_ThreadState)(tid);
 
+   /* Release any pages still pinned by an earlier syscall which did
+      not get as far as VG_(post_syscall), because it was interrupted
+      and is now being restarted. */
+   if (VG_(clo_smc_check) == Vg_SmcMprotect)
+      VG_(smc_kernel_writes_done)(tid);
+
    /* BEGIN ensure root thread's stack is suitably mapped */
    /* In some rare circumstances, we may do the syscall without the
       bottom page of the stack being mapped, because the stack pointer
@@ -2109,6 +2116,8 @@ void VG_(post_syscall) (ThreadId tid)
       a syscall. */
    if (sci->status.what == SsIdle || sci->status.what == SsHandToKernel) {
       sci->status.what = SsIdle;
+      if (VG_(clo_smc_check) == Vg_SmcMprotect)
+         VG_(smc_kernel_writes_done)(tid);
       return;
    }
 
@@ -2180,6 +2189,10 @@ void VG_(post_syscall) (ThreadId tid)
    vg_assert(sci->status.what == SsComplete);
    sci->status.what = SsIdle;
 
+   /* The kernel has finished writing to client memory. */
+   if (VG_(clo_smc_check) == Vg_SmcMprotect)
+      VG_(smc_kernel_writes_done)(tid);
+
    /* The pre/post wrappers may have concluded that pending signals
       might have been created, and will have set SfPollAfter to
       request a poll for them once the syscall is done. */
@@ -48,6 +48,7 @@
 #include "pub_core_options.h"
 #include "pub_core_tooliface.h"
 #include "pub_core_signals.h"
+#include "pub_core_transtab.h"
 #include "pub_core_syscall.h"
 #include "pub_core_syswrap.h"
 
@@ -39,6 +39,7 @@
 #include "pub_core_libcbase.h"
 #include "pub_core_libcassert.h"
 #include "pub_core_libcprint.h"
+#include "pub_core_libcproc.h"   // VG_(gettimeofday)
 #include "pub_core_options.h"
 
 #include "pub_core_debuginfo.h"  // VG_(get_fnname_w_offset)
@@ -75,6 +76,13 @@ static ULong n_PX_VexRegUpdUnwindregsAtMemAccess = 0;
 static ULong n_PX_VexRegUpdAllregsAtMemAccess    = 0;
 static ULong n_PX_VexRegUpdAllregsAtEachInsn     = 0;
 
+/* Translation throughput and register allocator output; only
+   gathered with --stats=yes. */
+static ULong n_host_instrs      = 0;
+static ULong n_regalloc_spills  = 0;
+static ULong n_regalloc_reloads = 0;
+static ULong translate_usecs    = 0;
+
 void VG_(print_translation_stats) ( void )
 {
    UInt n_SP_updates = n_SP_updates_fast + n_SP_updates_generic_known
@@ -99,6 +107,14 @@ void VG_(print_translation_stats) ( void )
 
    VG_(message)(Vg_DebugMsg,
                 "translate: PX: SPonly %'llu,  UnwRegs %'llu,  AllRegs %'llu,  AllRegsAllInsns %'llu\n", n_PX_VexRegUpdSpAtMemAccess, n_PX_VexRegUpdUnwindregsAtMemAccess, n_PX_VexRegUpdAllregsAtMemAccess, n_PX_VexRegUpdAllregsAtEachInsn);
+
+   VG_(message)(Vg_DebugMsg,
+                "translate: %'llu host insns in %'llu ms (%'llu per ms), "
+                "%'llu spills, %'llu reloads\n",
+                n_host_instrs, translate_usecs / 1000,
+                translate_usecs == 0 ? 0ULL
+                                     : n_host_instrs * 1000 / translate_usecs,
+                n_regalloc_spills, n_regalloc_reloads);
 }
 
 /*------------------------------------------------------------*/
@@ -780,6 +796,21 @@ static Bool translations_allowable_from_seg ( NSegment const* seg, Addr addr )
 }
 
 
+/* With --smc-check=mprotect, code is write-protected rather than
+   checked, except for code on the thread's stack, which is written to
+   all the time, and code from pages which have taken too many write
+   faults already. */
+static Bool smc_mprotect_needs_self_check ( ThreadId tid,
+                                            Addr addr, SizeT len )
+{
+   NSegment const* segA  = VG_(am_find_nsegment)(addr);
+   NSegment const* segSP = VG_(am_find_nsegment)(VG_(get_SP)(tid));
+   if (segA && segSP && segA == segSP)
+      return True;
+   return VG_(smc_range_is_write_hot)(addr, len);
+}
+
+
 /* Produce a bitmask stating which of the supplied extents needs a
    self-check.  See documentation of
    VexTranslateArgs::needs_self_check for more details about the
@@ -845,6 +876,10 @@ static UInt needs_self_check ( void* closureV,
                   check = True;
                break;
             }
+            case Vg_SmcMprotect:
+               check = smc_mprotect_needs_self_check(closure->tid,
+                                                     addr, len);
+               break;
             case Vg_SmcAllNonFile: {
                /* check if any part of the extent is not in a
                   file-mapped segment */
@@ -1762,7 +1797,19 @@ Bool VG_(translate) ( ThreadId tid,
       = VG_(fnptr_to_fnentry)( &VG_(disp_cp_xassisted) );
 
    /* Sheesh.  Finally, actually _do_ the translation! */
-   tres = LibVEX_Translate ( &vta );
+   if (VG_(clo_stats)) {
+      struct vki_timeval before, after;
+      VG_(gettimeofday)(&before, NULL);
+      tres = LibVEX_Translate ( &vta );
+      VG_(gettimeofday)(&after, NULL);
+      translate_usecs += (after.tv_sec - before.tv_sec) * 1000000ULL
+                         + after.tv_usec - before.tv_usec;
+      n_host_instrs      += tres.n_host_instrs;
+      n_regalloc_spills  += tres.n_spills;
+      n_regalloc_reloads += tres.n_reloads;
+   } else {
+      tres = LibVEX_Translate ( &vta );
+   }
 
    vg_assert(tres.status == VexTransOK);
    vg_assert(tres.n_sc_extents >= 0 && tres.n_sc_extents <= 3);
@@ -1776,6 +1823,15 @@ Bool VG_(translate) ( ThreadId tid,
       VG_(am_set_segment_hasT)( vge.base[i] );
    }
 
+   /* With --smc-check=mprotect, write-protect the code instead of
+      having checked it. */
+   if (VG_(clo_smc_check) == Vg_SmcMprotect && !debugging_translation) {
+      for (i = 0; i < vge.n_used; i++) {
+         if (!smc_mprotect_needs_self_check(tid, vge.base[i], vge.len[i]))
+            VG_(smc_protect_range)( vge.base[i], vge.len[i] );
+      }
+   }
+
    /* Copy data at trans_addr into the translation cache. */
    vg_assert(tmpbuf_used > 0 && tmpbuf_used < 65536);
 
@@ -43,6 +43,7 @@
 #include "pub_core_aspacemgr.h"
 #include "pub_core_mallocfree.h" // VG_(out_of_memory_NORETURN)
 #include "pub_core_xarray.h"
+#include "pub_core_oset.h"
 #include "pub_core_dispatch.h"   // For VG_(disp_cp*) addresses
 
 
@@ -453,6 +454,11 @@ static ULong n_sectors_recycled = 0;
 static ULong n_disc_count = 0;
 static ULong n_disc_osize = 0;
 
+/* Number of guest code pages write-protected, and of write faults on
+   them, with --smc-check=mprotect. */
+static ULong n_smc_protects     = 0;
+static ULong n_smc_write_faults = 0;
+
 
 /*-------------------------------------------------------------*/
 /*--- Misc                                                  ---*/
@@ -1840,6 +1846,7 @@ Bool VG_(search_transtab) ( /*OUT*/Addr*  res_hcode,
 
 /* forward */
 static void unredir_discard_translations( Addr, ULong );
+static void smc_forget_range( Addr, ULong );
 
 /* Stuff for deleting translations which intersect with a given
    address range.  Unfortunately, to make this run at a reasonable
@@ -2106,6 +2113,9 @@ void VG_(discard_translations) ( Addr guest_start, ULong range,
    /* don't forget the no-redir cache */
    unredir_discard_translations( guest_start, range );
 
+   /* nor the write-protection state of the pages */
+   smc_forget_range( guest_start, range );
+
    /* Post-deletion sanity check */
    if (VG_(clo_sanity_level >= 4)) {
       TTEno    i;
@@ -2140,6 +2150,328 @@ void VG_(discard_translations_safely) ( Addr  start, SizeT len,
    VG_(discard_translations)(start, len, who);
 }
 
+/*------------------------------------------------------------*/
+/*--- Write-protection of guest code (--smc-check=mprotect) ---*/
+/*------------------------------------------------------------*/
+
+/* With --smc-check=mprotect, rather than making translations
+   self-checking, the pages of writable client segments from which
+   translations are made are write-protected.  A write to such a page
+   faults; the signal handler then discards all translations from the
+   page and makes it writable again, so code which is never rewritten
+   costs nothing after translation.
+
+   smc_pages records each page which has been write-protected since it
+   was last mapped, or which a syscall in progress may write to.
+   .isWP says whether the page is known to still be write-protected,
+   so that making further translations from it need not mprotect it
+   again.  The records of a range are dropped whenever translations
+   covering it are discarded, which is what happens when the client
+   changes the mapping (munmap, mmap, mprotect, mremap, brk, ...).
+   Translations may also be discarded with the page still mapped as
+   before (VALGRIND_DISCARD_TRANSLATIONS, gdbserver, ...), so a page
+   which is still write-protected is made writable again before its
+   record goes.
+
+   The write fault handler does not discard translations itself: it
+   may have interrupted generated code, or the core in the middle of
+   anything.  It only makes the page writable and queues it in
+   smc_pending; the queued pages' translations are discarded by
+   VG_(smc_discard_pending), which the scheduler calls before running
+   generated code again.  The faulting thread is made to return to
+   the scheduler at the end of the current block, so that neither it
+   nor any other thread runs stale translations of the page after
+   that.
+
+   Pages which are written to repeatedly are better served by
+   self-checking translations than by taking a fault for each write,
+   so once a page has faulted SMC_MAX_WRITE_FAULTS times, translations
+   from it are made self-checking instead, and the page is no longer
+   protected.
+
+   The kernel does not fault on a protected page; the syscall fails
+   with EFAULT instead.  So the pages a syscall may write to are
+   unprotected before it starts, and "pinned" until it completes:
+   .n_kernel_writes counts the syscalls in progress which may write
+   to the page, and while it is nonzero the page is not protected
+   again, translations from it being made self-checking instead.
+   Without that, another thread could translate code from the page,
+   and so protect it, while the syscall is blocked.  smc_pins records
+   which thread pinned which page, so that the pins can be released
+   when the thread's syscall completes. */
+
+#define SMC_MAX_WRITE_FAULTS 4
+
+typedef
+   struct {
+      Addr page;      /* key */
+      Bool isWP;
+      Bool discardPending;
+      UInt n_write_faults;
+      UInt n_kernel_writes;
+   }
+   SmcPage;
+
+typedef
+   struct {
+      ThreadId tid;
+      Addr     page;
+   }
+   SmcPin;
+
+static OSet*   smc_pages = NULL;   /* of SmcPage */
+static XArray* smc_pins  = NULL;   /* of SmcPin */
+
+/* Pages whose translations are to be discarded.  This is filled in
+   by the signal handler, so it is a fixed-size array rather than an
+   XArray.  Should it overflow, smc_pending_overflow makes
+   VG_(smc_discard_pending) look for .discardPending in all of
+   smc_pages instead. */
+#define N_SMC_PENDING 16
+
+static Addr smc_pending[N_SMC_PENDING];
+static UInt n_smc_pending        = 0;
+static Bool smc_pending_overflow = False;
+
+/* True while smc_discard_page is discarding translations, so that
+   smc_forget_range leaves the records of the page alone. */
+static Bool smc_discarding = False;
+
+static SmcPage* smc_find_page ( Addr page, Bool create )
+{
+   SmcPage* sp;
+
+   if (smc_pages == NULL) {
+      if (!create)
+         return NULL;
+      smc_pages = VG_(OSetGen_Create)( offsetof(SmcPage, page), NULL,
+                                       ttaux_malloc, "transtab.smc_pages",
+                                       ttaux_free );
+   }
+   sp = VG_(OSetGen_Lookup)( smc_pages, &page );
+   if (sp == NULL && create) {
+      sp = VG_(OSetGen_AllocNode)( smc_pages, sizeof(SmcPage) );
+      sp->page = page;
+      sp->isWP = False;
+      sp->discardPending = False;
+      sp->n_write_faults = 0;
+      sp->n_kernel_writes = 0;
+      VG_(OSetGen_Insert)( smc_pages, sp );
+   }
+   return sp;
+}
+
+static void smc_remove_page ( Addr page )
+{
+   SmcPage* sp = VG_(OSetGen_Remove)( smc_pages, &page );
+   vg_assert(sp);
+   VG_(OSetGen_FreeNode)( smc_pages, sp );
+}
+
+/* Discard the translations from a page, in chunks small enough that
+   VG_(discard_translations) need only look at one equivalence class
+   at a time. */
+static void smc_discard_page ( Addr page, const HChar* who )
+{
+   Addr a;
+   vg_assert(!smc_discarding);
+   smc_discarding = True;
+   for (a = page; a < page + VKI_PAGE_SIZE; a += 1 << ECLASS_SHIFT)
+      VG_(discard_translations)( a, 1 << ECLASS_SHIFT, who );
+   smc_discarding = False;
+}
+
+static void smc_forget_range ( Addr start, ULong range )
+{
+   SmcPage* sp;
+   Addr     next;
+
+   if (smc_pages == NULL || range == 0 || smc_discarding)
+      return;
+   next = VG_PGROUNDDN(start);
+   while (True) {
+      VG_(OSetGen_ResetIterAt)( smc_pages, &next );
+      sp = VG_(OSetGen_Next)( smc_pages );
+      if (sp == NULL || sp->page >= start + range)
+         break;
+      next = sp->page + VKI_PAGE_SIZE;
+      /* This fails harmlessly if the page is no longer mapped, or no
+         longer writable by the client. */
+      if (sp->isWP)
+         VG_(am_set_client_write_protect)( sp->page, VKI_PAGE_SIZE, False );
+      /* The range's translations are gone already. */
+      sp->discardPending = False;
+      if (sp->n_kernel_writes > 0) {
+         /* Still pinned; VG_(smc_kernel_writes_done) removes it. */
+         sp->isWP = False;
+         sp->n_write_faults = 0;
+      } else {
+         smc_remove_page( sp->page );
+      }
+   }
+}
+
+Bool VG_(smc_range_is_write_hot) ( Addr start, SizeT len )
+{
+   Addr     page;
+   SmcPage* sp;
+
+   if (smc_pages == NULL)
+      return False;
+   for (page = VG_PGROUNDDN(start); page < start + (len ? len : 1);
+        page += VKI_PAGE_SIZE) {
+      sp = smc_find_page( page, False );
+      if (sp && (sp->n_write_faults >= SMC_MAX_WRITE_FAULTS
+                 || sp->n_kernel_writes > 0))
+         return True;
+   }
+   return False;
+}
+
+void VG_(smc_protect_range) ( Addr start, SizeT len )
+{
+   Addr     page;
+   SmcPage* sp;
+
+   vg_assert(VG_(clo_smc_check) == Vg_SmcMprotect);
+   for (page = VG_PGROUNDDN(start); page < start + (len ? len : 1);
+        page += VKI_PAGE_SIZE) {
+      NSegment const* seg = VG_(am_find_nsegment)( page );
+      if (seg == NULL || !seg->hasW)
+         continue;
+      sp = smc_find_page( page, True );
+      if (sp->isWP || sp->n_kernel_writes > 0)
+         continue;
+      if (VG_(am_set_client_write_protect)( page, VKI_PAGE_SIZE, True )) {
+         sp->isWP = True;
+         n_smc_protects++;
+      }
+   }
+}
+
+Bool VG_(smc_handle_write_fault) ( Addr fault )
+{
+   Addr            page = VG_PGROUNDDN(fault);
+   NSegment const* seg;
+   SmcPage*        sp;
+
+   /* It is only our fault if the client thinks the page is
+      writable. */
+   sp = smc_find_page( page, False );
+   if (sp == NULL)
+      return False;
+   seg = VG_(am_find_nsegment)( page );
+   if (seg == NULL || !seg->hasW)
+      return False;
+
+   if (!VG_(am_set_client_write_protect)( page, VKI_PAGE_SIZE, False ))
+      return False;
+   sp->isWP = False;
+   sp->n_write_faults++;
+   n_smc_write_faults++;
+   if (!sp->discardPending) {
+      sp->discardPending = True;
+      if (n_smc_pending < N_SMC_PENDING)
+         smc_pending[n_smc_pending++] = page;
+      else
+         smc_pending_overflow = True;
+   }
+   return True;
+}
+
+void VG_(smc_discard_pending) ( void )
+{
+   UInt     i;
+   SmcPage* sp;
+
+   for (i = 0; i < n_smc_pending; i++) {
+      sp = smc_find_page( smc_pending[i], False );
+      if (sp && sp->discardPending) {
+         sp->discardPending = False;
+         smc_discard_page( sp->page, "smc write fault" );
+      }
+   }
+   n_smc_pending = 0;
+
+   if (smc_pending_overflow) {
+      smc_pending_overflow = False;
+      /* smc_discard_page does not change smc_pages, so it is safe to
+         iterate over it meanwhile. */
+      VG_(OSetGen_ResetIter)( smc_pages );
+      while ((sp = VG_(OSetGen_Next)( smc_pages )) != NULL) {
+         if (sp->discardPending) {
+            sp->discardPending = False;
+            smc_discard_page( sp->page, "smc write fault" );
+         }
+      }
+   }
+}
+
+static void smc_pin_page ( ThreadId tid, Addr page )
+{
+   NSegment const* seg = VG_(am_find_nsegment)( page );
+   SmcPage*        sp;
+   SmcPin          pin;
+
+   if (seg == NULL || !seg->hasW)
+      return;
+   sp = smc_find_page( page, True );
+   if (sp->isWP) {
+      smc_discard_page( page, "smc kernel write" );
+      if (!VG_(am_set_client_write_protect)( page, VKI_PAGE_SIZE, False ))
+         return;
+      sp->isWP = False;
+   }
+   sp->n_kernel_writes++;
+   pin.tid  = tid;
+   pin.page = page;
+   VG_(addToXA)( smc_pins, &pin );
+}
+
+void VG_(smc_prepare_kernel_write) ( ThreadId tid, Addr start, SizeT len )
+{
+   Addr page, last;
+
+   vg_assert(VG_(clo_smc_check) == Vg_SmcMprotect);
+   /* Syscall arguments are not always pointers, so beware of ranges
+      which wrap around. */
+   if (len == 0 || start + len - 1 < start)
+      return;
+   if (smc_pins == NULL)
+      smc_pins = VG_(newXA)( ttaux_malloc, "transtab.smc_pins",
+                             ttaux_free, sizeof(SmcPin) );
+   last = VG_PGROUNDDN(start + len - 1);
+   for (page = VG_PGROUNDDN(start); ; page += VKI_PAGE_SIZE) {
+      smc_pin_page( tid, page );
+      if (page == last)
+         break;
+   }
+}
+
+void VG_(smc_kernel_writes_done) ( ThreadId tid )
+{
+   Word i;
+
+   if (smc_pins == NULL)
+      return;
+   for (i = VG_(sizeXA)( smc_pins ) - 1; i >= 0; i--) {
+      SmcPin*  pin = VG_(indexXA)( smc_pins, i );
+      SmcPage* sp;
+      if (pin->tid != tid)
+         continue;
+      sp = smc_find_page( pin->page, False );
+      vg_assert(sp && sp->n_kernel_writes > 0);
+      sp->n_kernel_writes--;
+      /* A page which was only recorded to be pinned is forgotten
+         again, so that smc_pages does not fill up with syscall
+         buffers. */
+      if (sp->n_kernel_writes == 0 && !sp->isWP && sp->n_write_faults == 0)
+         smc_remove_page( sp->page );
+      VG_(removeIndexXA)( smc_pins, i );
+   }
+}
+
+
 /*------------------------------------------------------------*/
 /*--- AUXILIARY: the unredirected TT/TC                    ---*/
 /*------------------------------------------------------------*/
@@ -2440,6 +2772,11 @@ void VG_(print_tt_tc_stats) ( void )
    VG_(message)(Vg_DebugMsg,
                 " transtab: discarded  %'llu (%'llu -> ?" "?)\n",
                 n_disc_count, n_disc_osize );
+   if (VG_(clo_smc_check) == Vg_SmcMprotect)
+      VG_(message)(Vg_DebugMsg,
+                   " transtab: smc        %'llu pages write-protected, "
+                   "%'llu write faults\n",
+                   n_smc_protects, n_smc_write_faults );
 
    if (DEBUG_TRANSTAB) {
       VG_(printf)("\n");
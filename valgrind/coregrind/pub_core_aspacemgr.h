@@ -277,6 +277,16 @@ extern Bool VG_(am_change_ownership_v_to_c)( Addr start, SizeT len );
    expected to belong to a client segment. */
 extern void VG_(am_set_segment_hasT)( Addr addr );
 
+/* Change the kernel's protection of the client pages [start,
+   start+len), which must lie in a single writable client segment, to
+   the segment's recorded protection, minus write permission if
+   WRITE_PROTECT.  The recorded protection is not changed.  This is
+   for --smc-check=mprotect, which write-protects pages translations
+   have been made from.  Returns False if the range is unsuitable or
+   the mprotect failed. */
+extern Bool VG_(am_set_client_write_protect)( Addr start, SizeT len,
+                                              Bool write_protect );
+
 /* --- --- --- reservations --- --- --- */
 
 /* Create a reservation from START .. START+LENGTH-1, with the given
@@ -80,6 +80,9 @@ extern void VG_(di_notify_vm_protect)( Addr a, SizeT len, UInt prot );
 
 extern void VG_(di_discard_ALL_debuginfo)( void );
 
+/* Print debug info reading statistics (for --stats=yes). */
+extern void VG_(print_debuginfo_stats)( void );
+
 /* Like VG_(get_fnname), but it does not do C++ demangling nor Z-demangling
  * nor below-main renaming.
  * It should not be used for any names that will be shown to users.
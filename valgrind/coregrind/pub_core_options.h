@@ -144,6 +144,10 @@ extern const HChar* VG_(clo_extra_debuginfo_path);
    "d.d.d.d:d", where d is one or more digits. */
 extern const HChar* VG_(clo_debuginfo_server);
 
+/* Directory in which to cache line number, inline and CFI tables
+   between runs, or NULL. */
+extern const HChar* VG_(clo_debuginfo_cache);
+
 /* Do we allow reading debuginfo from debuginfo objects that don't
    match (in some sense) the main object?  This is dangerous, so the
    default is NO (False).  In any case it applies only to objects
@@ -190,8 +194,12 @@ extern Bool  VG_(clo_debug_dump_frames);
 /* DEBUG: print redirection details?  default: NO */
 extern Bool  VG_(clo_trace_redir);
 /* Enable fair scheduling on multicore systems? default: NO */
-enum FairSchedType { disable_fair_sched, enable_fair_sched, try_fair_sched };
+enum FairSchedType { disable_fair_sched, enable_fair_sched, try_fair_sched,
+                     handoff_fair_sched };
 extern enum FairSchedType VG_(clo_fair_sched);
+/* Shorten timeslices while other threads are waiting for the CPU?
+   default: NO */
+extern Bool  VG_(clo_adaptive_timeslice);
 /* DEBUG: print thread scheduling events?  default: NO */
 extern Bool  VG_(clo_trace_sched);
 /* DEBUG: do heap profiling?  default: NO */
@@ -236,6 +244,8 @@ extern Bool VG_(clo_sym_offsets);
 extern Bool VG_(clo_read_inline_info);
 /* Read DWARF3 variable info even if tool doesn't ask for it? */
 extern Bool VG_(clo_read_var_info);
+/* Defer reading DWARF line, CFI and inline info until first use? */
+extern Bool VG_(clo_lazy_debuginfo);
 /* Which prefix to strip from full source file paths, if any. */
 extern const HChar* VG_(clo_prefix_to_strip);
 
@@ -304,6 +314,10 @@ extern UInt VG_(clo_max_threads);
    Note that the value is changeable by a gdbsrv command. */
 extern Int VG_(clo_merge_recursive_frames);
 
+/* Reuse the unchanged outer frames of a thread's previous stack trace
+   when unwinding its stack?  Currently only done on amd64. */
+extern Bool VG_(clo_stack_trace_cache);
+
 /* Max number of sectors that will be used by the translation code cache. */
 extern UInt VG_(clo_num_transtab_sectors);
 
@@ -331,8 +345,11 @@ typedef
       Vg_SmcStack, // generate s-c-t's for code found in stacks
                    // (this is the default)
       Vg_SmcAll,   // make all translations self-checking.
-      Vg_SmcAllNonFile // make all translations derived from
+      Vg_SmcAllNonFile, // make all translations derived from
                    // non-file-backed memory self checking
+      Vg_SmcMprotect // write-protect writable pages that translations
+                   // are made from; s-c-t's only for stacks and for
+                   // pages that are written to often
    } 
    VgSmc;
 
@@ -107,6 +107,12 @@ extern void VG_(scheduler_init_phase2) ( ThreadId main_tid,
 extern void VG_(disable_vgdb_poll) (void );
 extern void VG_(force_vgdb_poll) ( void );
 
+/* Make the thread TID, which must be running generated code, return
+   to the scheduler at the next event check, i.e. at the start of the
+   next block, rather than at the end of its timeslice.  For use from
+   the sync signal handler. */
+extern void VG_(stop_generated_code_soon) ( ThreadId tid );
+
 /* Stats ... */
 extern void VG_(print_scheduler_stats) ( void );
 
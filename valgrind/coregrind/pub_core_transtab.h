@@ -115,6 +115,28 @@ extern void VG_(discard_translations) ( Addr  start, ULong range,
 
 extern void VG_(print_tt_tc_stats) ( void );
 
+/* Support for --smc-check=mprotect.  VG_(smc_protect_range)
+   write-protects the pages of a guest code range from which a
+   translation has been made.  VG_(smc_handle_write_fault) is called on
+   a SEGV_ACCERR fault at FAULT; it returns True, having unprotected
+   the page, if the page was protected by us.  The page's translations
+   are discarded later, by VG_(smc_discard_pending), which must be
+   called before generated code is run again, and not from a signal
+   handler.  VG_(smc_prepare_kernel_write) must be called before a
+   syscall of thread TID may write to client memory, since such writes
+   do not fault; the pages stay unprotected until
+   VG_(smc_kernel_writes_done) is called for TID once the syscall has
+   completed.  VG_(smc_range_is_write_hot) says whether a range is
+   rewritten so often, or is about to be written by the kernel, that
+   its translations should be self-checking instead. */
+extern void VG_(smc_protect_range)         ( Addr start, SizeT len );
+extern Bool VG_(smc_handle_write_fault)    ( Addr fault );
+extern void VG_(smc_discard_pending)       ( void );
+extern void VG_(smc_prepare_kernel_write)  ( ThreadId tid,
+                                             Addr start, SizeT len );
+extern void VG_(smc_kernel_writes_done)    ( ThreadId tid );
+extern Bool VG_(smc_range_is_write_hot)    ( Addr start, SizeT len );
+
 extern UInt VG_(get_bbs_translated) ( void );
 
 /* Add to / search the auxiliary, small, unredirected translation
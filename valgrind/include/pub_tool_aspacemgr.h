@@ -154,6 +154,13 @@ extern Bool VG_(am_is_valid_for_client) ( Addr start, SizeT len,
 /* Really just a wrapper around VG_(am_mmap_anon_float_valgrind). */
 extern void* VG_(am_shadow_alloc)(SizeT size);
 
+/* As VG_(am_shadow_alloc), but SIZE must be a multiple of
+   VG_SHADOW_HUGE_SZB, and the block returned is aligned to that size.
+   On Linux the kernel is asked to back it with transparent huge pages,
+   which it may or may not do.  Returns NULL on failure. */
+#define VG_SHADOW_HUGE_SZB (2 * 1024 * 1024)
+extern void* VG_(am_shadow_alloc_huge)(SizeT size);
+
 /* Unmap the given address range and update the segment array
    accordingly.  This fails if the range isn't valid for valgrind. */
 extern SysRes VG_(am_munmap_valgrind)( Addr start, SizeT length );
@@ -279,6 +279,23 @@ static const HChar* pp_Reachedness_for_leak_kinds(Reachedness r)
    }
 }
 
+/* With --alloc-context-sampling, most blocks only have the innermost
+   frames of their allocation stack recorded.  Say so after printing
+   such a stack, so that it is not mistaken for the whole story. */
+static void pp_alloc_context_note ( ExeContext* ec )
+{
+   if (MC_(clo_alloc_context_sampling) <= 1
+       || ec == NULL
+       || !MC_(is_unsampled_alloc_context)(ec))
+      return;
+   if (VG_(clo_xml))
+      emit( "  <auxwhat>Allocation stack not sampled; "
+            "see --alloc-context-sampling</auxwhat>\n" );
+   else
+      emit( " (allocation stack not sampled; "
+            "see --alloc-context-sampling)\n" );
+}
+
 static void mc_pp_origin ( ExeContext* ec, UInt okind )
 {
    const HChar* src = NULL;
@@ -300,6 +317,15 @@ static void mc_pp_origin ( ExeContext* ec, UInt okind )
       emit( " Uninitialised value was created%s\n", src);
       VG_(pp_ExeContext)( ec );
    }
+   if (okind == MC_OKIND_HEAP)
+      pp_alloc_context_note( ec );
+}
+
+static void mc_pp_addrinfo ( Addr a, const AddrInfo* ai, Bool maybe_gcc )
+{
+   VG_(pp_addrinfo_mc)( a, ai, maybe_gcc );
+   if (ai->tag == Addr_Block)
+      pp_alloc_context_note( ai->Addr.Block.allocated_at );
 }
 
 HChar * MC_(snprintf_delta) (HChar * buf, Int size, 
@@ -380,6 +406,7 @@ static void pp_LossRecord(UInt n_this_record, UInt n_total_records,
          emit( "  </xwhat>\n" );
       }
       VG_(pp_ExeContext)(lr->key.allocated_at);
+      pp_alloc_context_note(lr->key.allocated_at);
    } else { /* ! if (xml) */
       if (lr->indirect_szB > 0) {
          emit(
@@ -402,6 +429,7 @@ static void pp_LossRecord(UInt n_this_record, UInt n_total_records,
          );
       }
       VG_(pp_ExeContext)(lr->key.allocated_at);
+      pp_alloc_context_note(lr->key.allocated_at);
    } /* if (xml) */
 }
 
@@ -510,8 +538,8 @@ void MC_(pp_Error) ( const Error* err )
                   extra->Err.MemParam.isAddrErr 
                      ? "unaddressable" : "uninitialised" );
             VG_(pp_ExeContext)( VG_(get_error_where)(err) );
-            VG_(pp_addrinfo_mc)(VG_(get_error_address)(err),
-                                &extra->Err.MemParam.ai, False);
+            mc_pp_addrinfo(VG_(get_error_address)(err),
+                           &extra->Err.MemParam.ai, False);
             if (extra->Err.MemParam.origin_ec 
                 && !extra->Err.MemParam.isAddrErr)
                mc_pp_origin( extra->Err.MemParam.origin_ec,
@@ -522,8 +550,8 @@ void MC_(pp_Error) ( const Error* err )
                   extra->Err.MemParam.isAddrErr 
                      ? "unaddressable" : "uninitialised" );
             VG_(pp_ExeContext)( VG_(get_error_where)(err) );
-            VG_(pp_addrinfo_mc)(VG_(get_error_address)(err),
-                                &extra->Err.MemParam.ai, False);
+            mc_pp_addrinfo(VG_(get_error_address)(err),
+                           &extra->Err.MemParam.ai, False);
             if (extra->Err.MemParam.origin_ec 
                 && !extra->Err.MemParam.isAddrErr)
                mc_pp_origin( extra->Err.MemParam.origin_ec,
@@ -541,8 +569,8 @@ void MC_(pp_Error) ( const Error* err )
                    extra->Err.User.isAddrErr
                       ? "Unaddressable" : "Uninitialised" );
             VG_(pp_ExeContext)( VG_(get_error_where)(err) );
-            VG_(pp_addrinfo_mc)(VG_(get_error_address)(err), &extra->Err.User.ai,
-                                False);
+            mc_pp_addrinfo(VG_(get_error_address)(err), &extra->Err.User.ai,
+                           False);
             if (extra->Err.User.origin_ec && !extra->Err.User.isAddrErr)
                mc_pp_origin( extra->Err.User.origin_ec,
                              extra->Err.User.otag & 3 );
@@ -551,8 +579,8 @@ void MC_(pp_Error) ( const Error* err )
                    extra->Err.User.isAddrErr
                       ? "Unaddressable" : "Uninitialised" );
             VG_(pp_ExeContext)( VG_(get_error_where)(err) );
-            VG_(pp_addrinfo_mc)(VG_(get_error_address)(err), &extra->Err.User.ai,
-                                False);
+            mc_pp_addrinfo(VG_(get_error_address)(err), &extra->Err.User.ai,
+                           False);
             if (extra->Err.User.origin_ec && !extra->Err.User.isAddrErr)
                mc_pp_origin( extra->Err.User.origin_ec,
                              extra->Err.User.otag & 3 );
@@ -565,13 +593,13 @@ void MC_(pp_Error) ( const Error* err )
             emit( "  <what>Invalid free() / delete / delete[]"
                   " / realloc()</what>\n" );
             VG_(pp_ExeContext)( VG_(get_error_where)(err) );
-            VG_(pp_addrinfo_mc)( VG_(get_error_address)(err),
-                                 &extra->Err.Free.ai, False );
+            mc_pp_addrinfo( VG_(get_error_address)(err),
+                            &extra->Err.Free.ai, False );
          } else {
             emit( "Invalid free() / delete / delete[] / realloc()\n" );
             VG_(pp_ExeContext)( VG_(get_error_where)(err) );
-            VG_(pp_addrinfo_mc)( VG_(get_error_address)(err),
-                                 &extra->Err.Free.ai, False );
+            mc_pp_addrinfo( VG_(get_error_address)(err),
+                            &extra->Err.Free.ai, False );
          }
          break;
 
@@ -580,13 +608,13 @@ void MC_(pp_Error) ( const Error* err )
             emit( "  <kind>MismatchedFree</kind>\n" );
             emit( "  <what>Mismatched free() / delete / delete []</what>\n" );
             VG_(pp_ExeContext)( VG_(get_error_where)(err) );
-            VG_(pp_addrinfo_mc)(VG_(get_error_address)(err),
-                                &extra->Err.FreeMismatch.ai, False);
+            mc_pp_addrinfo(VG_(get_error_address)(err),
+                           &extra->Err.FreeMismatch.ai, False);
          } else {
             emit( "Mismatched free() / delete / delete []\n" );
             VG_(pp_ExeContext)( VG_(get_error_where)(err) );
-            VG_(pp_addrinfo_mc)(VG_(get_error_address)(err),
-                                &extra->Err.FreeMismatch.ai, False);
+            mc_pp_addrinfo(VG_(get_error_address)(err),
+                           &extra->Err.FreeMismatch.ai, False);
          }
          break;
 
@@ -598,18 +626,18 @@ void MC_(pp_Error) ( const Error* err )
                   extra->Err.Addr.isWrite ? "write" : "read",
                   extra->Err.Addr.szB );
             VG_(pp_ExeContext)( VG_(get_error_where)(err) );
-            VG_(pp_addrinfo_mc)( VG_(get_error_address)(err),
-                                 &extra->Err.Addr.ai,
-                                 extra->Err.Addr.maybe_gcc );
+            mc_pp_addrinfo( VG_(get_error_address)(err),
+                            &extra->Err.Addr.ai,
+                            extra->Err.Addr.maybe_gcc );
          } else {
             emit( "Invalid %s of size %lu\n",
                   extra->Err.Addr.isWrite ? "write" : "read",
                   extra->Err.Addr.szB );
             VG_(pp_ExeContext)( VG_(get_error_where)(err) );
 
-            VG_(pp_addrinfo_mc)( VG_(get_error_address)(err),
-                                 &extra->Err.Addr.ai,
-                                 extra->Err.Addr.maybe_gcc );
+            mc_pp_addrinfo( VG_(get_error_address)(err),
+                            &extra->Err.Addr.ai,
+                            extra->Err.Addr.maybe_gcc );
          }
          break;
 
@@ -619,13 +647,13 @@ void MC_(pp_Error) ( const Error* err )
             emit( "  <what>Jump to the invalid address stated "
                   "on the next line</what>\n" );
             VG_(pp_ExeContext)( VG_(get_error_where)(err) );
-            VG_(pp_addrinfo_mc)( VG_(get_error_address)(err), &extra->Err.Jump.ai,
-                                 False );
+            mc_pp_addrinfo( VG_(get_error_address)(err), &extra->Err.Jump.ai,
+                            False );
          } else {
             emit( "Jump to the invalid address stated on the next line\n" );
             VG_(pp_ExeContext)( VG_(get_error_where)(err) );
-            VG_(pp_addrinfo_mc)( VG_(get_error_address)(err), &extra->Err.Jump.ai,
-                                 False );
+            mc_pp_addrinfo( VG_(get_error_address)(err), &extra->Err.Jump.ai,
+                            False );
          }
          break;
 
@@ -667,13 +695,13 @@ void MC_(pp_Error) ( const Error* err )
             emit( "  <kind>InvalidMemPool</kind>\n" );
             emit( "  <what>Illegal memory pool address</what>\n" );
             VG_(pp_ExeContext)( VG_(get_error_where)(err) );
-            VG_(pp_addrinfo_mc)( VG_(get_error_address)(err),
-                                 &extra->Err.IllegalMempool.ai, False );
+            mc_pp_addrinfo( VG_(get_error_address)(err),
+                            &extra->Err.IllegalMempool.ai, False );
          } else {
             emit( "Illegal memory pool address\n" );
             VG_(pp_ExeContext)( VG_(get_error_where)(err) );
-            VG_(pp_addrinfo_mc)( VG_(get_error_address)(err),
-                                 &extra->Err.IllegalMempool.ai, False );
+            mc_pp_addrinfo( VG_(get_error_address)(err),
+                            &extra->Err.IllegalMempool.ai, False );
          }
          break;
 
@@ -1085,7 +1113,7 @@ void MC_(pp_describe_addr) ( Addr a )
 
    ai.tag = Addr_Undescribed;
    describe_addr (a, &ai);
-   VG_(pp_addrinfo_mc) (a, &ai, /* maybe_gcc */ False);
+   mc_pp_addrinfo (a, &ai, /* maybe_gcc */ False);
    VG_(clear_addrinfo) (&ai);
 }
 
@@ -1223,6 +1251,8 @@ static Bool mempool_block_maybe_describe( Addr a,
 
    VG_(HT_ResetIter)( MC_(mempool_list) );
    while ( (mp = VG_(HT_Next)(MC_(mempool_list))) ) {
+      if (a < mp->lo || a >= mp->hi)
+         continue;
       if (mp->chunks != NULL) {
          MC_Chunk* mc;
          VG_(HT_ResetIter)(mp->chunks);
@@ -83,6 +83,10 @@ ExeContext* MC_(freed_at) (MC_Chunk*);
 void  MC_(set_allocated_at) (ThreadId, MC_Chunk*);
 void  MC_(set_freed_at) (ThreadId, MC_Chunk*);
 
+/* With --alloc-context-sampling, says whether EC is one of the short
+   contexts given to blocks whose allocation stack was not sampled. */
+Bool MC_(is_unsampled_alloc_context) (ExeContext* ec);
+
 /* number of pointers needed according to MC_(clo_keep_stacktraces). */
 UInt MC_(n_where_pointers) (void);
 
@@ -94,6 +98,15 @@ typedef
       SizeT         rzB;            // pool red-zone size
       Bool          is_zeroed;      // allocations from this pool are zeroed
       VgHashTable  *chunks;         // chunks associated with this pool
+      // [lo, hi) contains every chunk of the pool, redzones included.
+      // It is reset when the pool becomes empty, and otherwise only
+      // grows, so it is a cheap first test of whether an address can
+      // be in one of the pool's chunks.
+      Addr          lo;
+      Addr          hi;
+      // The chunks again, ordered by address, so that a chunk can be
+      // checked against its neighbours without sorting the pool.
+      struct _OSet* chunks_by_addr;
    }
    MC_Mempool;
 
@@ -120,6 +133,9 @@ Bool MC_(mempool_exists)  ( Addr pool );
    is found. */
 MC_Chunk* MC_(get_freed_block_bracketting)( Addr a );
 
+/* Prints the freed blocks queue statistics. */
+void MC_(print_freed_queue_stats) ( void );
+
 /* For efficient pooled alloc/free of the MC_Chunk. */
 extern PoolAlloc* MC_(chunk_poolalloc);
 
@@ -592,6 +608,14 @@ extern Bool MC_(clo_partial_loads_ok);
 /* Max volume of the freed blocks queue. */
 extern Long MC_(clo_freelist_vol);
 
+/* Record the full allocation stack of only one block in this many;
+   the others just get the allocating function.  Default: 1 (all) */
+extern Int MC_(clo_alloc_context_sampling);
+
+/* Size in megabytes of the first level origin tracking cache, used
+   with --track-origins=yes.  Default: 96 */
+extern Int MC_(clo_origin_cache_size);
+
 /* Blocks with a size >= MC_(clo_freelist_big_blocks) will be put
    in the "big block" freed blocks queue. */
 extern Long MC_(clo_freelist_big_blocks);
@@ -704,6 +728,10 @@ extern Bool MC_(clo_show_mismatched_frees);
    operations? Default: NO */
 extern Bool MC_(clo_expensive_definedness_checks);
 
+/* Should secondary shadow maps be allocated from huge-page arenas?
+   Default: NO */
+extern Bool MC_(clo_secmap_huge_pages);
+
 /*------------------------------------------------------------*/
 /*--- Instrumentation                                      ---*/
 /*------------------------------------------------------------*/
@@ -752,6 +780,14 @@ VG_REGPARM(1) UWord MC_(helperc_LOADV8)     ( Addr );
 void MC_(helperc_MAKE_STACK_UNINIT) ( Addr base, UWord len,
                                                  Addr nia );
 
+/* For the inline LOADV/STOREV fast paths generated by mc_translate.c:
+   the address of the primary map, the mask that turns (a >> 16) into
+   an index in it, and the mask of the address bits above the part of
+   the address space it covers.  Returns False if no fast paths should
+   be generated. */
+Bool MC_(get_primary_map_info) ( /*OUT*/Addr* pm, /*OUT*/UWord* ix_mask,
+                                 /*OUT*/UWord* high_mask );
+
 /* Origin tag load/store helpers */
 VG_REGPARM(2) void  MC_(helperc_b_store1) ( Addr a, UWord d32 );
 VG_REGPARM(2) void  MC_(helperc_b_store2) ( Addr a, UWord d32 );
@@ -479,6 +479,82 @@ LeakCheckDeltaMode MC_(detect_memory_leaks_last_delta_mode);
 // generation number.
 UInt MC_(leak_search_gen);
 
+// A filter in front of find_chunk_for, which is a binary search over
+// lc_chunks and is by far the most frequent operation of a leak search.
+// Most scanned words are not pointers into the heap at all.  Those outside
+// [lc_filter_min, lc_filter_max) are rejected straight away; of the rest,
+// those whose LC_FILTER_SHIFT-sized granule is not covered by any chunk
+// are rejected by a bitmap indexed by the low bits of the granule number.
+// Collisions in the bitmap only cause false positives, which the binary
+// search then resolves.  The filter describes lc_chunks, and so is
+// rebuilt and kept with it.
+#define LC_FILTER_SHIFT    10
+#define LC_FILTER_MIN_BITS 16
+#define LC_FILTER_MAX_BITS 28
+static UChar* lc_filter;
+static UWord  lc_filter_mask;
+static Addr   lc_filter_min;
+static Addr   lc_filter_max;
+
+static void lc_filter_set ( UWord granule )
+{
+   granule &= lc_filter_mask;
+   lc_filter[granule >> 3] |= 1 << (granule & 7);
+}
+
+static __inline__ Bool lc_filter_test ( Addr a )
+{
+   UWord granule = (a >> LC_FILTER_SHIFT) & lc_filter_mask;
+   return (lc_filter[granule >> 3] >> (granule & 7)) & 1;
+}
+
+static void lc_build_filter ( void )
+{
+   Int   i, bits;
+   UWord g, g_lo, g_hi, n_granules = 0;
+   MC_Chunk* ch;
+
+   if (lc_filter) {
+      VG_(free)(lc_filter);
+      lc_filter = NULL;
+   }
+   if (lc_n_chunks == 0)
+      return;
+
+   // Zero-sized blocks are treated as having size 1, as in find_chunk_for.
+   lc_filter_min = lc_chunks[0]->data;
+   lc_filter_max = 0;
+   for (i = 0; i < lc_n_chunks; i++) {
+      ch   = lc_chunks[i];
+      g_lo = ch->data >> LC_FILTER_SHIFT;
+      g_hi = (ch->data + (ch->szB == 0 ? 0 : ch->szB - 1)) >> LC_FILTER_SHIFT;
+      n_granules += g_hi - g_lo + 1;
+      if (ch->data + (ch->szB == 0 ? 1 : ch->szB) > lc_filter_max)
+         lc_filter_max = ch->data + (ch->szB == 0 ? 1 : ch->szB);
+   }
+
+   // About two bits per covered granule, within bounds.
+   for (bits = LC_FILTER_MIN_BITS;
+        bits < LC_FILTER_MAX_BITS && ((UWord)1 << bits) < 2 * n_granules;
+        bits++)
+      ;
+   lc_filter_mask = ((UWord)1 << bits) - 1;
+   lc_filter = VG_(calloc)("mc.lbf.1", ((UWord)1 << bits) / 8, 1);
+
+   for (i = 0; i < lc_n_chunks; i++) {
+      ch   = lc_chunks[i];
+      g_lo = ch->data >> LC_FILTER_SHIFT;
+      g_hi = (ch->data + (ch->szB == 0 ? 0 : ch->szB - 1)) >> LC_FILTER_SHIFT;
+      if (g_hi - g_lo >= lc_filter_mask) {
+         // This block alone covers every bit.
+         VG_(memset)(lc_filter, 0xFF, ((UWord)1 << bits) / 8);
+         break;
+      }
+      for (g = g_lo; g <= g_hi; g++)
+         lc_filter_set(g);
+   }
+}
+
 // Records chunks that are currently being processed.  Each element in the
 // stack is an index into lc_chunks and lc_extras.  Its size is
 // 'lc_n_chunks' because in the worst case that's how many chunks could be
@@ -525,6 +601,13 @@ lc_is_a_chunk_ptr(Addr ptr, Int* pch_no, MC_Chunk** pch, LC_Extra** pex)
    MC_Chunk* ch;
    LC_Extra* ex;
 
+   // Cheapest filter first: could ptr be inside any chunk at all ?
+   // lc_filter is NULL exactly when there are no chunks.
+   if (lc_filter == NULL
+       || ptr < lc_filter_min || ptr >= lc_filter_max
+       || !lc_filter_test(ptr))
+      return False;
+
    // Quick filter. Note: implemented with am, not with get_vabits2
    // as ptr might be random data pointing anywhere. On 64 bit
    // platforms, getting va bits for random data can be quite costly
@@ -1731,6 +1814,7 @@ void MC_(detect_memory_leaks) ( ThreadId tid, LeakCheckParams* lcp)
    lc_chunks_n_frees_marker = MC_(get_cmalloc_n_frees)();
    if (lc_n_chunks == 0) {
       tl_assert(lc_chunks == NULL);
+      lc_build_filter();
       if (lr_table != NULL) {
          // forget the previous recorded LossRecords as next leak search
          // can in any case just create new leaks.
@@ -1818,6 +1902,8 @@ void MC_(detect_memory_leaks) ( ThreadId tid, LeakCheckParams* lcp)
       }
    }
 
+   lc_build_filter();
+
    // Initialise lc_extras.
    if (lc_extras) {
       VG_(free)(lc_extras);
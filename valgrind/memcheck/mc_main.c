@@ -293,21 +293,78 @@ static INLINE Bool is_distinguished_sm ( SecMap* sm ) {
 // Forward declaration
 static void update_SM_counts(SecMap* oldSM, SecMap* newSM);
 
+/* Allocation of non-distinguished secondaries.  Normally each one is
+   a mapping of its own.  With --secmap-huge-pages=yes they are carved
+   out of huge-page-aligned arenas instead, so that the shadow of a
+   large heap costs one TLB entry per 2MB rather than one per 4KB;
+   freed secondaries then go onto a free list (linked through their
+   first word) and are never returned to the kernel.
+
+   *is_zero is set if the secondary is known to be all zeroes, as a
+   fresh anonymous mapping is. */
+
+static SecMap* sm_free_list  = NULL;
+static UChar*  sm_arena_next = NULL;
+static UChar*  sm_arena_end  = NULL;
+
+static SecMap* alloc_SecMap ( Bool* is_zero )
+{
+   SecMap* sm;
+
+   if (!MC_(clo_secmap_huge_pages)) {
+      *is_zero = True;
+      return VG_(am_shadow_alloc)(sizeof(SecMap));
+   }
+
+   if (sm_free_list != NULL) {
+      sm = sm_free_list;
+      sm_free_list = *(SecMap**)sm;
+      *is_zero = False;
+      return sm;
+   }
+   if (sm_arena_next == sm_arena_end) {
+      sm_arena_next = VG_(am_shadow_alloc_huge)(VG_SHADOW_HUGE_SZB);
+      if (sm_arena_next == NULL)
+         return NULL;
+      sm_arena_end = sm_arena_next + VG_SHADOW_HUGE_SZB;
+   }
+   sm = (SecMap*)sm_arena_next;
+   sm_arena_next += sizeof(SecMap);
+   *is_zero = True;
+   return sm;
+}
+
+static void free_SecMap ( SecMap* sm )
+{
+   if (!MC_(clo_secmap_huge_pages)) {
+      SysRes sres = VG_(am_munmap_valgrind)((Addr)sm, sizeof(SecMap));
+      tl_assert2(! sr_isError(sres), "SecMap valgrind munmap failure\n");
+      return;
+   }
+   *(SecMap**)sm = sm_free_list;
+   sm_free_list = sm;
+}
+
 /* dist_sm points to one of our three distinguished secondaries.  Make
    a copy of it so that we can write to it.
 */
 static SecMap* copy_for_writing ( SecMap* dist_sm )
 {
    SecMap* new_sm;
+   Bool    is_zero;
    tl_assert(dist_sm == &sm_distinguished[0]
           || dist_sm == &sm_distinguished[1]
           || dist_sm == &sm_distinguished[2]);
+   STATIC_ASSERT(VA_BITS8_NOACCESS == 0);
 
-   new_sm = VG_(am_shadow_alloc)(sizeof(SecMap));
+   new_sm = alloc_SecMap(&is_zero);
    if (new_sm == NULL)
       VG_(out_of_memory_NORETURN)( "memcheck:allocate new SecMap", 
                                    sizeof(SecMap) );
-   VG_(memcpy)(new_sm, dist_sm, sizeof(SecMap));
+   /* A zeroed secondary is already all-noaccess.  Not writing it means
+      its pages are only materialised when they are first written. */
+   if (!(is_zero && dist_sm == &sm_distinguished[SM_DIST_NOACCESS]))
+      VG_(memcpy)(new_sm, dist_sm, sizeof(SecMap));
    update_SM_counts(dist_sm, new_sm);
    return new_sm;
 }
@@ -339,6 +396,10 @@ static Int   n_sanity_expensive = 0;
 static Int   n_secVBit_nodes   = 0;
 static Int   max_secVBit_nodes = 0;
 
+/* # of secondaries found to be uniform after a range write, and so
+   replaced by a distinguished one. */
+static Int   n_reclaimed_SMs   = 0;
+
 static void update_SM_counts(SecMap* oldSM, SecMap* newSM)
 {
    if      (oldSM == &sm_distinguished[SM_DIST_NOACCESS ]) n_noaccess_SMs --;
@@ -1549,12 +1610,44 @@ void mc_STOREVn_slow ( Addr a, SizeT nBits, ULong vbytes, Bool bigendian )
 /*--- Setting permissions over address ranges.             ---*/
 /*------------------------------------------------------------*/
 
+/* After a large part of a non-distinguished secondary has been set to
+   the state of example_dsm, check whether all of it now is.  If so,
+   free it and share the distinguished secondary instead; the V bits of
+   any bytes that were partially defined before are no longer
+   referenced, and will be dropped by the next sec-V-bits GC.
+
+   This is only done with --secmap-huge-pages=yes, where freeing a
+   secondary puts it on the free list.  Otherwise it would be unmapped,
+   and a secondary whose halves are set alternately, as happens with
+   stack frames that keep straddling it, would be unmapped and mapped
+   again over and over. */
+static void maybe_reclaim_SM ( SecMap** sm_ptr, SecMap* example_dsm )
+{
+   const UWord* p = (const UWord*)(*sm_ptr)->vabits8;
+   const UWord* q = (const UWord*)example_dsm->vabits8;
+   UWord i, n = sizeof(SecMap) / sizeof(UWord);
+
+   tl_assert(!is_distinguished_sm(*sm_ptr));
+   if (!MC_(clo_secmap_huge_pages))
+      return;
+   /* Check the ends first, which are the most likely to differ. */
+   if (p[0] != q[0] || p[n-1] != q[0])
+      return;
+   for (i = 1; i < n-1; i++)
+      if (p[i] != q[0])
+         return;
+   free_SecMap(*sm_ptr);
+   update_SM_counts(*sm_ptr, example_dsm);
+   *sm_ptr = example_dsm;
+   n_reclaimed_SMs++;
+}
+
 static void set_address_range_perms ( Addr a, SizeT lenT, UWord vabits16,
                                       UWord dsm_num )
 {
-   UWord    sm_off, sm_off16;
+   UWord    sm_off;
    UWord    vabits2 = vabits16 & 0x3;
-   SizeT    lenA, lenB, len_to_next_secmap;
+   SizeT    lenA, lenB, len8, len_to_next_secmap, len_written;
    Addr     aNext;
    SecMap*  sm;
    SecMap** sm_ptr;
@@ -1676,6 +1769,7 @@ static void set_address_range_perms ( Addr a, SizeT lenT, UWord vabits16,
       }
    }
    sm = *sm_ptr;
+   len_written = lenA;
 
    // 1 byte steps
    while (True) {
@@ -1687,14 +1781,13 @@ static void set_address_range_perms ( Addr a, SizeT lenT, UWord vabits16,
       a    += 1;
       lenA -= 1;
    }
-   // 8-aligned, 8 byte steps
-   while (True) {
-      if (lenA < 8) break;
+   // 8-aligned, 8 byte steps, done as one memset of the vabits8
+   if (lenA >= 8) {
       PROF_EVENT(MCPE_SET_ADDRESS_RANGE_PERMS_LOOP8A);
-      sm_off16 = SM_OFF_16(a);
-      ((UShort*)(sm->vabits8))[sm_off16] = vabits16;
-      a    += 8;
-      lenA -= 8;
+      len8 = lenA & ~(SizeT)7;
+      VG_(memset)(&sm->vabits8[SM_OFF(a)], vabits16 & 0xFF, len8 >> 2);
+      a    += len8;
+      lenA -= len8;
    }
    // 1 byte steps
    while (True) {
@@ -1706,6 +1799,9 @@ static void set_address_range_perms ( Addr a, SizeT lenT, UWord vabits16,
       lenA -= 1;
    }
 
+   if (len_written >= SM_SIZE/4 && !is_distinguished_sm(sm))
+      maybe_reclaim_SM(sm_ptr, example_dsm);
+
    // We've finished the first sec-map.  Is that it?
    if (lenB == 0)
       return;
@@ -1726,8 +1822,7 @@ static void set_address_range_perms ( Addr a, SizeT lenT, UWord vabits16,
          PROF_EVENT(MCPE_SET_ADDRESS_RANGE_PERMS_LOOP64K_FREE_DIST_SM);
          // Free the non-distinguished sec-map that we're replacing.  This
          // case happens moderately often, enough to be worthwhile.
-         SysRes sres = VG_(am_munmap_valgrind)((Addr)*sm_ptr, sizeof(SecMap));
-         tl_assert2(! sr_isError(sres), "SecMap valgrind munmap failure\n");
+         free_SecMap(*sm_ptr);
       }
       update_SM_counts(*sm_ptr, example_dsm);
       // Make the sec-map entry point to the example DSM
@@ -1759,25 +1854,28 @@ static void set_address_range_perms ( Addr a, SizeT lenT, UWord vabits16,
       }
    }
    sm = *sm_ptr;
+   len_written = lenB;
 
-   // 8-aligned, 8 byte steps
-   while (True) {
-      if (lenB < 8) break;
+   // 8-aligned, 8 byte steps, done as one memset of the vabits8
+   if (lenB >= 8) {
       PROF_EVENT(MCPE_SET_ADDRESS_RANGE_PERMS_LOOP8B);
-      sm_off16 = SM_OFF_16(a);
-      ((UShort*)(sm->vabits8))[sm_off16] = vabits16;
-      a    += 8;
-      lenB -= 8;
+      len8 = lenB & ~(SizeT)7;
+      VG_(memset)(&sm->vabits8[SM_OFF(a)], vabits16 & 0xFF, len8 >> 2);
+      a    += len8;
+      lenB -= len8;
    }
    // 1 byte steps
    while (True) {
-      if (lenB < 1) return;
+      if (lenB < 1) break;
       PROF_EVENT(MCPE_SET_ADDRESS_RANGE_PERMS_LOOP1C);
       sm_off = SM_OFF(a);
       insert_vabits2_into_vabits8( a, vabits2, &(sm->vabits8[sm_off]) );
       a    += 1;
       lenB -= 1;
    }
+
+   if (len_written >= SM_SIZE/4)
+      maybe_reclaim_SM(sm_ptr, example_dsm);
 }
 
 
@@ -1908,29 +2006,54 @@ void MC_(copy_address_range_state) ( Addr src, Addr dst, SizeT len )
 
    if (nooverlap && aligned) {
 
-      /* Vectorised fast case, when no overlap and suitably aligned */
-      /* vector loop */
+      /* Vectorised fast case, when no overlap and suitably aligned.
+         Work through the range in pieces that lie within a single
+         secondary map at both ends.  A piece of a distinguished source
+         secondary is uniform, so just set the destination to the same
+         state; otherwise copy the vabits8 directly, and then find the
+         few bytes (if any) whose V bits live in the sec-V-bits
+         table. */
       i = 0;
       while (len >= 4) {
-         vabits8 = get_vabits8_for_aligned_word32( src+i );
-         set_vabits8_for_aligned_word32( dst+i, vabits8 );
-         if (LIKELY(VA_BITS8_DEFINED == vabits8 
-                            || VA_BITS8_UNDEFINED == vabits8 
-                            || VA_BITS8_NOACCESS == vabits8)) {
-            /* do nothing */
+         SizeT   n, k;
+         SecMap* src_sm = get_secmap_for_reading( src+i );
+         SecMap* dst_sm;
+         const UChar* sp;
+         UChar*  dp;
+
+         n = len & ~(SizeT)3;
+         if (n > SM_SIZE - ((src+i) & SM_MASK))
+            n = SM_SIZE - ((src+i) & SM_MASK);
+         if (n > SM_SIZE - ((dst+i) & SM_MASK))
+            n = SM_SIZE - ((dst+i) & SM_MASK);
+         tl_assert(n >= 4 && (n & 3) == 0);
+
+         if (is_distinguished_sm(src_sm)) {
+            UWord dsm_num  = src_sm - &sm_distinguished[0];
+            UWord vabits16 = dsm_num == SM_DIST_DEFINED   ? VA_BITS16_DEFINED
+                           : dsm_num == SM_DIST_UNDEFINED ? VA_BITS16_UNDEFINED
+                           : VA_BITS16_NOACCESS;
+            set_address_range_perms( dst+i, n, vabits16, dsm_num );
          } else {
-            /* have to copy secondary map info */
-            if (VA_BITS2_PARTDEFINED == get_vabits2( src+i+0 ))
-               set_sec_vbits8( dst+i+0, get_sec_vbits8( src+i+0 ) );
-            if (VA_BITS2_PARTDEFINED == get_vabits2( src+i+1 ))
-               set_sec_vbits8( dst+i+1, get_sec_vbits8( src+i+1 ) );
-            if (VA_BITS2_PARTDEFINED == get_vabits2( src+i+2 ))
-               set_sec_vbits8( dst+i+2, get_sec_vbits8( src+i+2 ) );
-            if (VA_BITS2_PARTDEFINED == get_vabits2( src+i+3 ))
-               set_sec_vbits8( dst+i+3, get_sec_vbits8( src+i+3 ) );
+            dst_sm = get_secmap_for_writing( dst+i );
+            sp = &src_sm->vabits8[SM_OFF(src+i)];
+            dp = &dst_sm->vabits8[SM_OFF(dst+i)];
+            VG_(memcpy)( dp, sp, n >> 2 );
+            for (k = 0; k < (n >> 2); k++) {
+               vabits8 = sp[k];
+               /* Is any 2-bit field VA_BITS2_PARTDEFINED (11b)? */
+               if (LIKELY((vabits8 & (vabits8 >> 1) & 0x55) == 0))
+                  continue;
+               /* have to copy secondary map info */
+               for (j = 0; j < 4; j++) {
+                  if (VA_BITS2_PARTDEFINED == ((vabits8 >> (2*j)) & 3))
+                     set_sec_vbits8( dst+i+4*k+j,
+                                     get_sec_vbits8( src+i+4*k+j ) );
+               }
+            }
          }
-         i += 4;
-         len -= 4;
+         i += n;
+         len -= n;
       }
       /* fixup loop */
       while (len >= 1) {
@@ -2048,8 +2171,9 @@ void MC_(copy_address_range_state) ( Addr src, Addr dst, SizeT len )
 
    Memory is shadowed using a two level cache structure (ocacheL1 and
    ocacheL2).  Memory references are first directed to ocacheL1.  This
-   is a traditional 2-way set associative cache with 32-byte lines and
-   approximate LRU replacement within each set.
+   is a traditional 4-way set associative cache with 32-byte lines and
+   approximate LRU replacement within each set.  Its size is set by
+   --origin-cache-size.
 
    A naive implementation would require storing one 32 bit otag for
    each byte of memory covered, a 4:1 space overhead.  Instead, there
@@ -2291,6 +2415,8 @@ static UWord stats_ocacheL1_found_at_N     = 0;
 static UWord stats_ocacheL1_misses         = 0;
 static UWord stats_ocacheL1_lossage        = 0;
 static UWord stats_ocacheL1_movefwds       = 0;
+static UWord stats_ocacheL1_evict_empty    = 0;
+static UWord stats_ocacheL1_evict_zero     = 0;
 
 static UWord stats__ocacheL2_refs          = 0;
 static UWord stats__ocacheL2_misses        = 0;
@@ -2308,12 +2434,10 @@ static INLINE Bool is_valid_oc_tag ( Addr tag ) {
    return 0 == (tag & ((1 << OC_BITS_PER_LINE) - 1));
 }
 
-#define OC_LINES_PER_SET 2
+#define OC_LINES_PER_SET 4
 
-#define OC_N_SET_BITS    20
-#define OC_N_SETS        (1 << OC_N_SET_BITS)
-
-/* These settings give:
+/* The number of sets is the largest power of two that fits in
+   --origin-cache-size megabytes.  The default of 96 gives:
    64 bit host: ocache:  100,663,296 sizeB    67,108,864 useful
    32 bit host: ocache:   92,274,688 sizeB    67,108,864 useful
 */
@@ -2352,30 +2476,31 @@ typedef
    }
    OCacheSet;
 
-typedef
-   struct {
-      OCacheSet set[OC_N_SETS];
-   }
-   OCache;
-
-static OCache* ocacheL1 = NULL;
-static UWord   ocacheL1_event_ctr = 0;
+static OCacheSet* ocacheL1 = NULL;
+static UWord      ocacheL1_n_sets    = 0;  /* a power of 2 */
+static UWord      ocacheL1_set_mask  = 0;  /* ocacheL1_n_sets - 1 */
+static UWord      ocacheL1_event_ctr = 0;
 
 static void init_ocacheL2 ( void ); /* fwds */
 static void init_OCache ( void )
 {
    UWord line, set;
+   ULong szB = (ULong)MC_(clo_origin_cache_size) * 1024 * 1024;
    tl_assert(MC_(clo_mc_level) >= 3);
    tl_assert(ocacheL1 == NULL);
-   ocacheL1 = VG_(am_shadow_alloc)(sizeof(OCache));
+   ocacheL1_n_sets = 1;
+   while (2 * ocacheL1_n_sets * sizeof(OCacheSet) <= szB)
+      ocacheL1_n_sets *= 2;
+   ocacheL1_set_mask = ocacheL1_n_sets - 1;
+   ocacheL1 = VG_(am_shadow_alloc)(ocacheL1_n_sets * sizeof(OCacheSet));
    if (ocacheL1 == NULL) {
       VG_(out_of_memory_NORETURN)( "memcheck:allocating ocacheL1", 
-                                   sizeof(OCache) );
+                                   ocacheL1_n_sets * sizeof(OCacheSet) );
    }
    tl_assert(ocacheL1 != NULL);
-   for (set = 0; set < OC_N_SETS; set++) {
+   for (set = 0; set < ocacheL1_n_sets; set++) {
       for (line = 0; line < OC_LINES_PER_SET; line++) {
-         ocacheL1->set[set].line[line].tag = 1/*invalid*/;
+         ocacheL1[set].line[line].tag = 1/*invalid*/;
       }
    }
    init_ocacheL2();
@@ -2476,14 +2601,15 @@ static OCacheLine* find_OCacheLine_SLOW ( Addr a )
    OCacheLine *victim, *inL2;
    UChar c;
    UWord line;
-   UWord setno   = (a >> OC_BITS_PER_LINE) & (OC_N_SETS - 1);
+   UWord setno   = (a >> OC_BITS_PER_LINE) & ocacheL1_set_mask;
    UWord tagmask = ~((1 << OC_BITS_PER_LINE) - 1);
    UWord tag     = a & tagmask;
-   tl_assert(setno >= 0 && setno < OC_N_SETS);
+   OCacheSet* set = &ocacheL1[setno];
+   tl_assert(setno >= 0 && setno < ocacheL1_n_sets);
 
    /* we already tried line == 0; skip therefore. */
    for (line = 1; line < OC_LINES_PER_SET; line++) {
-      if (ocacheL1->set[setno].line[line].tag == tag) {
+      if (set->line[line].tag == tag) {
          if (line == 1) {
             stats_ocacheL1_found_at_1++;
          } else {
@@ -2491,26 +2617,36 @@ static OCacheLine* find_OCacheLine_SLOW ( Addr a )
          }
          if (UNLIKELY(0 == (ocacheL1_event_ctr++ 
                             & ((1<<OC_MOVE_FORWARDS_EVERY_BITS)-1)))) {
-            moveLineForwards( &ocacheL1->set[setno], line );
+            moveLineForwards( set, line );
             line--;
          }
-         return &ocacheL1->set[setno].line[line];
+         return &set->line[line];
       }
    }
 
-   /* A miss.  Use the last slot.  Implicitly this means we're
-      ejecting the line in the last slot. */
+   /* A miss.  The victim comes from the less recently used half of the
+      set.  Within that, prefer a line that is empty or holds no
+      origins, since ejecting those loses nothing and does not grow the
+      L2; failing that, eject the line in the last slot. */
    stats_ocacheL1_misses++;
    tl_assert(line == OC_LINES_PER_SET);
    line--;
+   for (; line >= OC_LINES_PER_SET/2; line--) {
+      c = classify_OCacheLine(&set->line[line]);
+      if (c != 'n')
+         break;
+   }
+   if (line < OC_LINES_PER_SET/2)
+      line = OC_LINES_PER_SET - 1;
    tl_assert(line > 0);
 
    /* First, move the to-be-ejected line to the L2 cache. */
-   victim = &ocacheL1->set[setno].line[line];
+   victim = &set->line[line];
    c = classify_OCacheLine(victim);
    switch (c) {
       case 'e':
          /* the line is empty (has invalid tag); ignore it. */
+         stats_ocacheL1_evict_empty++;
          break;
       case 'z':
          /* line contains zeroes.  We must ensure the backing store is
@@ -2518,6 +2654,7 @@ static OCacheLine* find_OCacheLine_SLOW ( Addr a )
             verbatim, or by ensuring it isn't present there.  We
             chosse the latter on the basis that it reduces the size of
             the backing store. */
+         stats_ocacheL1_evict_zero++;
          ocacheL2_del_tag( victim->tag );
          break;
       case 'n':
@@ -2541,36 +2678,36 @@ static OCacheLine* find_OCacheLine_SLOW ( Addr a )
    inL2 = ocacheL2_find_tag( tag );
    if (inL2) {
       /* We're in luck.  It's in the L2. */
-      ocacheL1->set[setno].line[line] = *inL2;
+      set->line[line] = *inL2;
    } else {
       /* Missed at both levels of the cache hierarchy.  We have to
          declare it as full of zeroes (unknown origins). */
       stats__ocacheL2_misses++;
-      zeroise_OCacheLine( &ocacheL1->set[setno].line[line], tag );
+      zeroise_OCacheLine( &set->line[line], tag );
    }
 
    /* Move it one forwards */
-   moveLineForwards( &ocacheL1->set[setno], line );
+   moveLineForwards( set, line );
    line--;
 
-   return &ocacheL1->set[setno].line[line];
+   return &set->line[line];
 }
 
 static INLINE OCacheLine* find_OCacheLine ( Addr a )
 {
-   UWord setno   = (a >> OC_BITS_PER_LINE) & (OC_N_SETS - 1);
+   UWord setno   = (a >> OC_BITS_PER_LINE) & ocacheL1_set_mask;
    UWord tagmask = ~((1 << OC_BITS_PER_LINE) - 1);
    UWord tag     = a & tagmask;
 
    stats_ocacheL1_find++;
 
    if (OC_ENABLE_ASSERTIONS) {
-      tl_assert(setno >= 0 && setno < OC_N_SETS);
+      tl_assert(setno >= 0 && setno < ocacheL1_n_sets);
       tl_assert(0 == (tag & (4 * OC_W32S_PER_LINE - 1)));
    }
 
-   if (LIKELY(ocacheL1->set[setno].line[0].tag == tag)) {
-      return &ocacheL1->set[setno].line[0];
+   if (LIKELY(ocacheL1[setno].line[0].tag == tag)) {
+      return &ocacheL1[setno].line[0];
    }
 
    return find_OCacheLine_SLOW( a );
@@ -3751,6 +3888,81 @@ typedef
    exist, *bad_addr is set to the offending address, so the caller can
    know what it is. */
 
+/* The range checks below look at one byte at a time only where that
+   is needed, that is, around the first byte in the wrong state.  The
+   rest is skipped by uniform_prefix, which returns the length of the
+   longest prefix of [a, a+len) that is known to be entirely in state
+   |want|: all of a distinguished secondary of the right kind at once,
+   and in real secondaries a word's worth of vabits8 at a time.  It
+   may stop early (e.g. at an unaligned address); the caller then
+   deals with one byte and calls it again. */
+typedef
+   enum { UP_NoAccess, UP_Addressable, UP_Defined }
+   UniformWant;
+
+/* Are all the 2-bit fields of |vabits| (one or more vabits8, with
+   |ones| being 0x55 repeated over the same width) in state |want|? */
+static INLINE Bool vabits_are ( UWord vabits, UWord ones, UniformWant want )
+{
+   switch (want) {
+      case UP_NoAccess:    return vabits == 0;
+      case UP_Defined:     return vabits == 2 * ones;
+      case UP_Addressable: return ((vabits | (vabits >> 1)) & ones) == ones;
+      default: tl_assert(0);
+   }
+}
+
+static SizeT uniform_prefix ( Addr a, SizeT len, UniformWant want )
+{
+   const UWord ones = ~(UWord)0 / 3;   /* 0x5555... */
+   SizeT done = 0;
+
+   while (done < len) {
+      Addr    cur = a + done;
+      SizeT   n   = SM_SIZE - (cur & SM_MASK);
+      SecMap* sm  = get_secmap_for_reading( cur );
+      const UChar* p;
+      SizeT   k, nq;
+
+      if (n > len - done)
+         n = len - done;
+
+      if (is_distinguished_sm(sm)) {
+         Bool ok = want == UP_NoAccess
+                   ? sm == &sm_distinguished[SM_DIST_NOACCESS]
+                   : want == UP_Defined
+                   ? sm == &sm_distinguished[SM_DIST_DEFINED]
+                   : sm != &sm_distinguished[SM_DIST_NOACCESS];
+         if (!ok)
+            return done;
+         done += n;
+         continue;
+      }
+
+      if (!VG_IS_4_ALIGNED(cur))
+         return done;
+      p  = &sm->vabits8[SM_OFF(cur)];
+      nq = n >> 2;
+      k  = 0;
+      while (k < nq && !VG_IS_WORD_ALIGNED(p + k)
+             && vabits_are(p[k], 0x55, want))
+         k++;
+      if (VG_IS_WORD_ALIGNED(p + k)) {
+         while (k + sizeof(UWord) <= nq
+                && vabits_are(*(const UWord*)(p + k), ones, want))
+            k += sizeof(UWord);
+      }
+      while (k < nq && vabits_are(p[k], 0x55, want))
+         k++;
+      done += k << 2;
+      /* Stop if something did not match, or if what is left of the
+         range is less than 4 bytes. */
+      if (k < nq || (n & 3) != 0)
+         return done;
+   }
+   return done;
+}
+
 /* Returns True if [a .. a+len) is not addressible.  Otherwise,
    returns False, and if bad_addr is non-NULL, sets *bad_addr to
    indicate the lowest failing address.  Functions below are
@@ -3762,6 +3974,11 @@ Bool MC_(check_mem_is_noaccess) ( Addr a, SizeT len, Addr* bad_addr )
 
    PROF_EVENT(MCPE_CHECK_MEM_IS_NOACCESS);
    for (i = 0; i < len; i++) {
+      SizeT skip = uniform_prefix(a, len - i, UP_NoAccess);
+      a += skip;
+      i += skip;
+      if (i == len)
+         break;
       PROF_EVENT(MCPE_CHECK_MEM_IS_NOACCESS_LOOP);
       vabits2 = get_vabits2(a);
       if (VA_BITS2_NOACCESS != vabits2) {
@@ -3781,6 +3998,11 @@ static Bool is_mem_addressable ( Addr a, SizeT len,
 
    PROF_EVENT(MCPE_IS_MEM_ADDRESSABLE);
    for (i = 0; i < len; i++) {
+      SizeT skip = uniform_prefix(a, len - i, UP_Addressable);
+      a += skip;
+      i += skip;
+      if (i == len)
+         break;
       PROF_EVENT(MCPE_IS_MEM_ADDRESSABLE_LOOP);
       vabits2 = get_vabits2(a);
       if (VA_BITS2_NOACCESS == vabits2) {
@@ -3798,13 +4020,21 @@ static MC_ReadResult is_mem_defined ( Addr a, SizeT len,
 {
    SizeT i;
    UWord vabits2;
+   UniformWant want;
 
    PROF_EVENT(MCPE_IS_MEM_DEFINED);
    DEBUG("is_mem_defined\n");
 
    if (otag)     *otag = 0;
    if (bad_addr) *bad_addr = 0;
+   /* Without undefined value checking, only addressability matters. */
+   want = MC_(clo_mc_level) >= 2 ? UP_Defined : UP_Addressable;
    for (i = 0; i < len; i++) {
+      SizeT skip = uniform_prefix(a, len - i, want);
+      a += skip;
+      i += skip;
+      if (i == len)
+         break;
       PROF_EVENT(MCPE_IS_MEM_DEFINED_LOOP);
       vabits2 = get_vabits2(a);
       if (VA_BITS2_DEFINED != vabits2) {
@@ -4429,6 +4659,22 @@ STATIC_ASSERT(V_BITS8_UNDEFINED == 0xFF);
            = 0xFFFF'FFF0'0000'0007
 */
 
+/* The inline fast paths in mc_translate.c are the equivalent of the
+   LIKELY cases of mc_LOADV64/mc_STOREV64 and the 32-bit variants, so
+   only generate them if those are enabled. */
+Bool MC_(get_primary_map_info) ( /*OUT*/Addr* pm, /*OUT*/UWord* ix_mask,
+                                 /*OUT*/UWord* high_mask )
+{
+#if defined(PERF_FAST_LOADV) && defined(PERF_FAST_STOREV)
+   *pm        = (Addr)&primary_map[0];
+   *ix_mask   = N_PRIMARY_MAP - 1;
+   *high_mask = MASK(1);
+   return True;
+#else
+   return False;
+#endif
+}
+
 /*------------------------------------------------------------*/
 /*--- LOADV256 and LOADV128                                ---*/
 /*------------------------------------------------------------*/
@@ -5694,6 +5940,8 @@ static Bool mc_expensive_sanity_check ( void )
    Not doing so causes lots of false errors. */
 Bool          MC_(clo_partial_loads_ok)       = True;
 Long          MC_(clo_freelist_vol)           = 20*1000*1000LL;
+Int           MC_(clo_origin_cache_size)      = 96;
+Int           MC_(clo_alloc_context_sampling) = 1;
 Long          MC_(clo_freelist_big_blocks)    =  1*1000*1000LL;
 LeakCheckMode MC_(clo_leak_check)             = LC_Summary;
 VgRes         MC_(clo_leak_resolution)        = Vg_HighRes;
@@ -5710,6 +5958,7 @@ KeepStacktraces MC_(clo_keep_stacktraces)     = KS_alloc_and_free;
 Int           MC_(clo_mc_level)               = 2;
 Bool          MC_(clo_show_mismatched_frees)  = True;
 Bool          MC_(clo_expensive_definedness_checks) = False;
+Bool          MC_(clo_secmap_huge_pages)      = False;
 
 static const HChar * MC_(parse_leak_heuristics_tokens) =
    "-,stdstring,length64,newarray,multipleinheritance";
@@ -5787,6 +6036,12 @@ static Bool mc_process_cmd_line_options(const HChar* arg)
    else if VG_BOOL_CLO(arg, "--workaround-gcc296-bugs",
                                             MC_(clo_workaround_gcc296_bugs)) {}
 
+   else if VG_BINT_CLO(arg, "--origin-cache-size",
+                       MC_(clo_origin_cache_size), 1, 4096) {}
+
+   else if VG_BINT_CLO(arg, "--alloc-context-sampling",
+                       MC_(clo_alloc_context_sampling), 1, 1000000) {}
+
    else if VG_BINT_CLO(arg, "--freelist-vol",  MC_(clo_freelist_vol), 
                                                0, 10*1000*1000*1000LL) {}
 
@@ -5858,6 +6113,8 @@ static Bool mc_process_cmd_line_options(const HChar* arg)
                        MC_(clo_show_mismatched_frees)) {}
    else if VG_BOOL_CLO(arg, "--expensive-definedness-checks",
                        MC_(clo_expensive_definedness_checks)) {}
+   else if VG_BOOL_CLO(arg, "--secmap-huge-pages",
+                       MC_(clo_secmap_huge_pages)) {}
 
    else
       return VG_(replacement_malloc_process_cmd_line_option)(arg);
@@ -5892,6 +6149,7 @@ static void mc_print_usage(void)
 "                                     same as --show-leak-kinds=definite\n"
 "    --undef-value-errors=no|yes      check for undefined value errors [yes]\n"
 "    --track-origins=no|yes           show origins of undefined values? [no]\n"
+"    --origin-cache-size=<number>     size of origin cache in megabytes [96]\n"
 "    --partial-loads-ok=no|yes        too hard to explain here; see manual [yes]\n"
 "    --expensive-definedness-checks=no|yes\n"
 "                                     Use extra-precise definedness tracking [no]\n"
@@ -5903,7 +6161,10 @@ static void mc_print_usage(void)
 "    --free-fill=<hexnumber>          fill free'd areas with given value\n"
 "    --keep-stacktraces=alloc|free|alloc-and-free|alloc-then-free|none\n"
 "        stack trace(s) to keep for malloc'd/free'd areas       [alloc-and-free]\n"
+"    --alloc-context-sampling=<number>  record the full allocation stack\n"
+"                                     of one block in <number> [1]\n"
 "    --show-mismatched-frees=no|yes   show frees that don't match the allocator? [yes]\n"
+"    --secmap-huge-pages=no|yes       keep shadow memory in huge pages [no]\n"
    );
 }
 
@@ -7489,8 +7750,8 @@ static void mc_post_clo_init ( void )
    VG_(track_new_mem_brk)         ( make_mem_defined_w_tid );
 #  endif
 
-   /* This origin tracking cache is huge (~100M), so only initialise
-      if we need it. */
+   /* This origin tracking cache is huge (~100M by default), so only
+      initialise if we need it. */
    if (MC_(clo_mc_level) >= 3) {
       init_OCache();
       tl_assert(ocacheL1 != NULL);
@@ -7526,8 +7787,7 @@ static void mc_print_stats (void)
 {
    SizeT max_secVBit_szB, max_SMs_szB, max_shmem_szB;
 
-   VG_(message)(Vg_DebugMsg, " memcheck: freelist: vol %lld length %lld\n",
-                VG_(free_queue_volume), VG_(free_queue_length));
+   MC_(print_freed_queue_stats)();
    VG_(message)(Vg_DebugMsg,
       " memcheck: sanity checks: %d cheap, %d expensive\n",
       n_sanity_cheap, n_sanity_expensive );
@@ -7553,6 +7813,8 @@ static void mc_print_stats (void)
    print_SM_info("max_undefined", max_undefined_SMs);
    print_SM_info("max_defined  ", max_defined_SMs);
    print_SM_info("max_non_DSM  ", max_non_DSM_SMs);
+   VG_(message)(Vg_DebugMsg,
+      " memcheck: SMs: n_reclaimed   = %d\n", n_reclaimed_SMs);
 
    // Three DSMs, plus the non-DSM ones
    max_SMs_szB = (3 + max_non_DSM_SMs) * sizeof(SecMap);
@@ -7595,9 +7857,14 @@ static void mc_print_stats (void)
                    stats_ocacheL1_found_at_N,
                    stats_ocacheL1_movefwds );
       VG_(message)(Vg_DebugMsg,
-                   " ocacheL1: %'12lu sizeB  %'12d useful\n",
-                   (SizeT)sizeof(OCache),
-                   4 * OC_W32S_PER_LINE * OC_LINES_PER_SET * OC_N_SETS );
+                   " ocacheL1: %'12lu evictions of empty, %'lu of zero lines\n",
+                   stats_ocacheL1_evict_empty,
+                   stats_ocacheL1_evict_zero );
+      VG_(message)(Vg_DebugMsg,
+                   " ocacheL1: %'12lu sizeB  %'12lu useful (%lu sets x %d)\n",
+                   ocacheL1_n_sets * sizeof(OCacheSet),
+                   4 * OC_W32S_PER_LINE * OC_LINES_PER_SET * ocacheL1_n_sets,
+                   ocacheL1_n_sets, OC_LINES_PER_SET );
       VG_(message)(Vg_DebugMsg,
                    " ocacheL2: %'12lu refs   %'12lu misses\n",
                    stats__ocacheL2_refs, 
@@ -38,6 +38,7 @@
 #include "pub_tool_libcprint.h"
 #include "pub_tool_mallocfree.h"
 #include "pub_tool_options.h"
+#include "pub_tool_oset.h"
 #include "pub_tool_replacemalloc.h"
 #include "pub_tool_threadstate.h"
 #include "pub_tool_tooliface.h"     // Needed for mc_include.h
@@ -81,18 +82,60 @@ static inline
 void delete_MC_Chunk (MC_Chunk* mc);
 
 /* Records blocks after freeing. */
-/* Blocks freed by the client are queued in one of two lists of
+/* Blocks freed by the client are queued in one of two queues of
    freed blocks not yet physically freed:
-   "big blocks" freed list.
-   "small blocks" freed list
+   "big blocks" freed queue.
+   "small blocks" freed queue
    The blocks with a size >= MC_(clo_freelist_big_blocks)
-   are linked in the big blocks freed list.
+   are put in the big blocks freed queue.
    This allows a client to allocate and free big blocks
    (e.g. bigger than VG_(clo_freelist_vol)) without losing
    immediately all protection against dangling pointers.
-   position [0] is for big blocks, [1] is for small blocks. */
-static MC_Chunk* freed_list_start[2]  = {NULL, NULL};
-static MC_Chunk* freed_list_end[2]    = {NULL, NULL};
+   position [0] is for big blocks, [1] is for small blocks.
+
+   Each queue is a ring of descriptors, oldest first, which grows by
+   doubling when full.  The descriptors repeat the address and size of
+   their block, so that releasing blocks and searching the queue for
+   the block bracketting an address walk through a dense array rather
+   than chasing a pointer per block. */
+typedef
+   struct {
+      Addr      data;
+      SizeT     szB;
+      MC_Chunk* mc;
+   }
+   FreedDesc;
+
+typedef
+   struct {
+      FreedDesc* desc;
+      UWord      size;   /* a power of 2, or 0 if desc is NULL */
+      UWord      head;   /* index of the oldest descriptor */
+      UWord      used;
+   }
+   FreedRing;
+
+static FreedRing freed_queue[2];
+
+/* Stats */
+static ULong freed_queue_n_released   = 0;
+static ULong freed_queue_bs_released  = 0;
+static ULong freed_queue_n_batches    = 0;
+static Long  freed_queue_max_length   = 0;
+
+static void grow_freed_ring ( FreedRing* r )
+{
+   UWord      i, new_size = r->size == 0 ? 256 : 2 * r->size;
+   FreedDesc* new_desc    = VG_(malloc)("mc.gfr.1",
+                                        new_size * sizeof(FreedDesc));
+   for (i = 0; i < r->used; i++)
+      new_desc[i] = r->desc[(r->head + i) & (r->size - 1)];
+   if (r->desc)
+      VG_(free)(r->desc);
+   r->desc = new_desc;
+   r->size = new_size;
+   r->head = 0;
+}
 
 /* Put a shadow chunk on the freed blocks queue, possibly freeing up
    some of the oldest blocks in the queue at the same time. */
@@ -100,35 +143,39 @@ static void add_to_freed_queue ( MC_Chunk* mc )
 {
    const Bool show = False;
    const int l = (mc->szB >= MC_(clo_freelist_big_blocks) ? 0 : 1);
+   FreedRing* r = &freed_queue[l];
+   FreedDesc* d;
 
-   /* Put it at the end of the freed list, unless the block
+   if (r->used == r->size)
+      grow_freed_ring(r);
+
+   /* Put it at the end of the freed queue, unless the block
       would be directly released any way : in this case, we
-      put it at the head of the freed list. */
-   if (freed_list_end[l] == NULL) {
-      tl_assert(freed_list_start[l] == NULL);
-      mc->next = NULL;
-      freed_list_end[l]    = freed_list_start[l] = mc;
+      put it at the head of the freed queue. */
+   if (r->used > 0 && mc->szB >= MC_(clo_freelist_vol)) {
+      r->head = (r->head - 1) & (r->size - 1);
+      d = &r->desc[r->head];
    } else {
-      tl_assert(freed_list_end[l]->next == NULL);
-      if (mc->szB >= MC_(clo_freelist_vol)) {
-         mc->next = freed_list_start[l];
-         freed_list_start[l] = mc;
-      } else {
-         mc->next = NULL;
-         freed_list_end[l]->next = mc;
-         freed_list_end[l]       = mc;
-      }
+      d = &r->desc[(r->head + r->used) & (r->size - 1)];
    }
+   r->used++;
+   d->data = mc->data;
+   d->szB  = mc->szB;
+   d->mc   = mc;
+   mc->next = NULL;
+
    VG_(free_queue_volume) += (Long)mc->szB;
    if (show)
       VG_(printf)("mc_freelist: acquire: volume now %lld\n", 
                   VG_(free_queue_volume));
    VG_(free_queue_length)++;
+   if (VG_(free_queue_length) > freed_queue_max_length)
+      freed_queue_max_length = VG_(free_queue_length);
 }
 
 /* Release enough of the oldest blocks to bring the free queue
    volume below vg_clo_freelist_vol. 
-   Start with big block list first.
+   Start with big block queue first.
    On entry, VG_(free_queue_volume) must be > MC_(clo_freelist_vol).
    On exit, VG_(free_queue_volume) will be <= MC_(clo_freelist_vol). */
 static void release_oldest_block(void)
@@ -136,33 +183,32 @@ static void release_oldest_block(void)
    const Bool show = False;
    int i;
    tl_assert (VG_(free_queue_volume) > MC_(clo_freelist_vol));
-   tl_assert (freed_list_start[0] != NULL || freed_list_start[1] != NULL);
+   tl_assert (freed_queue[0].used > 0 || freed_queue[1].used > 0);
 
+   freed_queue_n_batches++;
    for (i = 0; i < 2; i++) {
+      FreedRing* r = &freed_queue[i];
       while (VG_(free_queue_volume) > MC_(clo_freelist_vol)
-             && freed_list_start[i] != NULL) {
-         MC_Chunk* mc1;
+             && r->used > 0) {
+         FreedDesc* d = &r->desc[r->head];
+         MC_Chunk*  mc1 = d->mc;
 
-         tl_assert(freed_list_end[i] != NULL);
-         
-         mc1 = freed_list_start[i];
-         VG_(free_queue_volume) -= (Long)mc1->szB;
+         tl_assert(mc1->data == d->data && mc1->szB == d->szB);
+         r->head = (r->head + 1) & (r->size - 1);
+         r->used--;
+
+         VG_(free_queue_volume) -= (Long)d->szB;
          VG_(free_queue_length)--;
+         freed_queue_n_released++;
+         freed_queue_bs_released += d->szB;
          if (show)
             VG_(printf)("mc_freelist: discard: volume now %lld\n", 
                         VG_(free_queue_volume));
          tl_assert(VG_(free_queue_volume) >= 0);
-         
-         if (freed_list_start[i] == freed_list_end[i]) {
-            freed_list_start[i] = freed_list_end[i] = NULL;
-         } else {
-            freed_list_start[i] = mc1->next;
-         }
-         mc1->next = NULL; /* just paranoia */
 
          /* free MC_Chunk */
          if (MC_AllocCustom != mc1->allockind)
-            VG_(cli_free) ( (void*)(mc1->data) );
+            VG_(cli_free) ( (void*)(d->data) );
          delete_MC_Chunk ( mc1 );
       }
    }
@@ -170,20 +216,31 @@ static void release_oldest_block(void)
 
 MC_Chunk* MC_(get_freed_block_bracketting) (Addr a)
 {
-   int i;
+   int   i;
+   UWord j;
    for (i = 0; i < 2; i++) {
-      MC_Chunk*  mc;
-      mc = freed_list_start[i];
-      while (mc) {
-         if (VG_(addr_is_in_block)( a, mc->data, mc->szB,
+      const FreedRing* r = &freed_queue[i];
+      for (j = 0; j < r->used; j++) {
+         const FreedDesc* d = &r->desc[(r->head + j) & (r->size - 1)];
+         if (VG_(addr_is_in_block)( a, d->data, d->szB,
                                     MC_(Malloc_Redzone_SzB) ))
-            return mc;
-         mc = mc->next;
+            return d->mc;
       }
    }
    return NULL;
 }
 
+void MC_(print_freed_queue_stats) ( void )
+{
+   VG_(message)(Vg_DebugMsg, " memcheck: freelist: vol %lld length %lld\n",
+                VG_(free_queue_volume), VG_(free_queue_length));
+   VG_(message)(Vg_DebugMsg,
+                " memcheck: freelist: %'llu released (%'llu bytes) "
+                "in %'llu batches, max length %'lld\n",
+                freed_queue_n_released, freed_queue_bs_released,
+                freed_queue_n_batches, freed_queue_max_length);
+}
+
 /* Allocate a shadow chunk, put it on the appropriate list.
    If needed, release oldest blocks from freed list. */
 static
@@ -292,6 +349,74 @@ ExeContext* MC_(freed_at) (MC_Chunk* mc)
    }
 }
 
+/* --alloc-context-sampling=N: the number of allocations still to be
+   skipped before the next one whose full stack is recorded.  The gaps
+   are drawn uniformly from [0, 2N-2], so that on average one
+   allocation in N is sampled, without locking onto any periodic
+   allocation pattern of the client.  The seed is fixed, so that runs
+   of the same program sample the same blocks. */
+static UInt alloc_sample_countdown = 0;
+static UInt alloc_sample_seed      = 0;
+
+static Bool alloc_context_is_sampled ( void )
+{
+   const UInt n = MC_(clo_alloc_context_sampling);
+   if (n <= 1)
+      return True;
+   if (alloc_sample_countdown > 0) {
+      alloc_sample_countdown--;
+      return False;
+   }
+   alloc_sample_countdown = VG_(random)(&alloc_sample_seed) % (2 * n - 1);
+   return True;
+}
+
+/* The blocks which are not sampled get a two-frame context: the
+   allocator's replacement function and its caller.  The ECUs of those
+   contexts are kept here, so that a short context can be told apart
+   from a full stack which happens to be short. */
+#define N_UNSAMPLED_IPS 2
+
+typedef
+   struct _UnsampledEC {
+      struct _UnsampledEC* next;
+      UWord                ecu;
+   }
+   UnsampledEC;
+
+static VgHashTable *unsampled_ecs = NULL;   /* of UnsampledEC */
+
+static ExeContext* record_unsampled_alloc_context ( ThreadId tid )
+{
+   Addr        ips[N_UNSAMPLED_IPS];
+   UInt        n_ips;
+   ExeContext* ec;
+   UWord       ecu;
+
+   n_ips = VG_(get_StackTrace)( tid, ips, N_UNSAMPLED_IPS,
+                                NULL/*array to dump SP values in*/,
+                                NULL/*array to dump FP values in*/,
+                                0/*first_ip_delta*/ );
+   ec = VG_(make_ExeContext_from_StackTrace)( ips, n_ips );
+
+   if (unsampled_ecs == NULL)
+      unsampled_ecs = VG_(HT_construct)( "mc.unsampled_ecs" );
+   ecu = VG_(get_ECU_from_ExeContext)( ec );
+   if (VG_(HT_lookup)( unsampled_ecs, ecu ) == NULL) {
+      UnsampledEC* node = VG_(malloc)( "mc.ruac.1", sizeof(UnsampledEC) );
+      node->ecu = ecu;
+      VG_(HT_add_node)( unsampled_ecs, node );
+   }
+   return ec;
+}
+
+Bool MC_(is_unsampled_alloc_context) ( ExeContext* ec )
+{
+   return unsampled_ecs != NULL
+          && VG_(HT_lookup)( unsampled_ecs,
+                             VG_(get_ECU_from_ExeContext)( ec ) ) != NULL;
+}
+
 void  MC_(set_allocated_at) (ThreadId tid, MC_Chunk* mc)
 {
    switch (MC_(clo_keep_stacktraces)) {
@@ -302,7 +427,12 @@ void  MC_(set_allocated_at) (ThreadId tid, MC_Chunk* mc)
       case KS_alloc_and_free:  break;
       default: tl_assert (0);
    }
-   mc->where[0] = VG_(record_ExeContext) ( tid, 0/*first_ip_delta*/ );
+   /* There is nothing to save if the full stack is no deeper. */
+   if (VG_(clo_backtrace_size) <= N_UNSAMPLED_IPS
+       || alloc_context_is_sampled())
+      mc->where[0] = VG_(record_ExeContext) ( tid, 0/*first_ip_delta*/ );
+   else
+      mc->where[0] = record_unsampled_alloc_context ( tid );
 }
 
 void  MC_(set_freed_at) (ThreadId tid, MC_Chunk* mc)
@@ -674,6 +804,88 @@ void MC_(handle_resizeInPlace)(ThreadId tid, Addr p,
 
 static void check_mempool_sane(MC_Mempool* mp); /*forward*/
 
+/* The pool used by the last mempool request.  Allocator annotations
+   come in long runs against the same pool, so this saves most of the
+   lookups in MC_(mempool_list). */
+static MC_Mempool* last_mempool = NULL;
+
+static MC_Mempool* find_mempool ( Addr pool )
+{
+   if (last_mempool != NULL && last_mempool->pool == pool)
+      return last_mempool;
+   last_mempool = VG_(HT_lookup)(MC_(mempool_list), (UWord)pool);
+   return last_mempool;
+}
+
+/* An element of a pool's chunks_by_addr.  A chunk that starts where
+   another one does is left out; the pool is bad anyway. */
+typedef
+   struct {
+      Addr      data;   // must be first: the key
+      MC_Chunk* mc;
+   }
+   MpChunkRef;
+
+/* Compare the range [key[0], key[1]) with a chunk: 0 if they overlap.
+   This only finds every overlap if the chunks in the set do not
+   overlap each other, which holds as long as the pool is sane. */
+static Word mp_cmp_range ( const void* key, const void* elem )
+{
+   const Addr*        range = key;
+   const MpChunkRef*  ref   = elem;
+   if (range[1] <= ref->data)                return -1;
+   if (range[0] >= ref->data + ref->mc->szB) return  1;
+   return 0;
+}
+
+/* Add MC to the pool's chunks_by_addr.  Returns False if it overlaps
+   a chunk already there, in O(log n) rather than the O(n log n) of
+   check_mempool_sane. */
+static Bool mp_order_add ( MC_Mempool* mp, MC_Chunk* mc )
+{
+   Addr        range[2];
+   MpChunkRef* ref;
+   Bool        ok;
+
+   range[0] = mc->data;
+   range[1] = mc->data + mc->szB;
+   ok = VG_(OSetGen_LookupWithCmp)(mp->chunks_by_addr, range,
+                                   mp_cmp_range) == NULL;
+   if (VG_(OSetGen_Contains)(mp->chunks_by_addr, &mc->data))
+      return False;
+   ref = VG_(OSetGen_AllocNode)(mp->chunks_by_addr, sizeof(MpChunkRef));
+   ref->data = mc->data;
+   ref->mc   = mc;
+   VG_(OSetGen_Insert)(mp->chunks_by_addr, ref);
+   return ok;
+}
+
+/* Remove MC from the pool's chunks_by_addr, if it is there. */
+static void mp_order_remove ( MC_Mempool* mp, MC_Chunk* mc )
+{
+   MpChunkRef* ref = VG_(OSetGen_Lookup)(mp->chunks_by_addr, &mc->data);
+   if (ref != NULL && ref->mc == mc) {
+      VG_(OSetGen_Remove)(mp->chunks_by_addr, &mc->data);
+      VG_(OSetGen_FreeNode)(mp->chunks_by_addr, ref);
+   }
+}
+
+static void extend_mempool_bounds ( MC_Mempool* mp, Addr a, SizeT szB )
+{
+   Addr lo = a >= mp->rzB ? a - mp->rzB : 0;
+   Addr hi = a + szB + mp->rzB;
+   if (hi < a)
+      hi = ~(Addr)0;
+   if (VG_(HT_count_nodes)(mp->chunks) == 1) {
+      /* The chunk just added is the only one. */
+      mp->lo = lo;
+      mp->hi = hi;
+   } else {
+      if (lo < mp->lo) mp->lo = lo;
+      if (hi > mp->hi) mp->hi = hi;
+   }
+}
+
 
 void MC_(create_mempool)(Addr pool, UInt rzB, Bool is_zeroed)
 {
@@ -696,6 +908,10 @@ void MC_(create_mempool)(Addr pool, UInt rzB, Bool is_zeroed)
    mp->rzB        = rzB;
    mp->is_zeroed  = is_zeroed;
    mp->chunks     = VG_(HT_construct)( "MC_(create_mempool)" );
+   mp->lo         = 0;
+   mp->hi         = 0;
+   mp->chunks_by_addr = VG_(OSetGen_Create)(/*keyOff*/0, NULL, VG_(malloc),
+                                            "mc.cm.2", VG_(free));
    check_mempool_sane(mp);
 
    /* Paranoia ... ensure this area is off-limits to the client, so
@@ -722,6 +938,7 @@ void MC_(destroy_mempool)(Addr pool)
    }
 
    mp = VG_(HT_remove) ( MC_(mempool_list), (UWord)pool );
+   last_mempool = NULL;
 
    if (mp == NULL) {
       ThreadId tid = VG_(get_running_tid)();
@@ -738,6 +955,7 @@ void MC_(destroy_mempool)(Addr pool)
       MC_(make_mem_noaccess)(mc->data-mp->rzB, mc->szB + 2*mp->rzB );
    }
    // Destroy the chunk table
+   VG_(OSetGen_Destroy)(mp->chunks_by_addr);
    VG_(HT_destruct)(mp->chunks, (void (*)(void *))delete_MC_Chunk);
 
    VG_(free)(mp);
@@ -839,13 +1057,15 @@ void MC_(mempool_alloc)(ThreadId tid, Addr pool, Addr addr, SizeT szB)
       VG_(get_and_pp_StackTrace) (tid, MEMPOOL_DEBUG_STACKTRACE_DEPTH);
    }
 
-   mp = VG_(HT_lookup) ( MC_(mempool_list), (UWord)pool );
+   mp = find_mempool ( pool );
    if (mp == NULL) {
       MC_(record_illegal_mempool_error) ( tid, pool );
    } else {
       if (MP_DETAILED_SANITY_CHECKS) check_mempool_sane(mp);
       MC_(new_block)(tid, addr, szB, /*ignored*/0, mp->is_zeroed,
                      MC_AllocCustom, mp->chunks);
+      mp_order_add(mp, VG_(HT_lookup)(mp->chunks, (UWord)addr));
+      extend_mempool_bounds(mp, addr, szB);
       if (mp->rzB > 0) {
          // This is not needed if the user application has properly
          // marked the superblock noaccess when defining the mempool.
@@ -864,7 +1084,7 @@ void MC_(mempool_free)(Addr pool, Addr addr)
    MC_Chunk*    mc;
    ThreadId     tid = VG_(get_running_tid)();
 
-   mp = VG_(HT_lookup)(MC_(mempool_list), (UWord)pool);
+   mp = find_mempool(pool);
    if (mp == NULL) {
       MC_(record_illegal_mempool_error)(tid, pool);
       return;
@@ -881,6 +1101,7 @@ void MC_(mempool_free)(Addr pool, Addr addr)
       MC_(record_free_error)(tid, (Addr)addr);
       return;
    }
+   mp_order_remove(mp, mc);
 
    if (VG_(clo_verbosity) > 2) {
       VG_(message)(Vg_UserMsg, 
@@ -951,6 +1172,7 @@ void MC_(mempool_trim)(Addr pool, Addr addr, SizeT szB)
             if (MP_DETAILED_SANITY_CHECKS) check_mempool_sane(mp);
             return;
          }
+         mp_order_remove(mp, mc);
          die_and_free_mem ( tid, mc, mp->rzB );  
 
       } else {
@@ -966,6 +1188,7 @@ void MC_(mempool_trim)(Addr pool, Addr addr, SizeT szB)
             if (MP_DETAILED_SANITY_CHECKS) check_mempool_sane(mp);
             return;
          }
+         mp_order_remove(mp, mc);
 
          if (mc->data < addr) {
            min = mc->data;
@@ -998,6 +1221,7 @@ void MC_(mempool_trim)(Addr pool, Addr addr, SizeT szB)
          mc->data = lo;
          mc->szB = (UInt) (hi - lo);
          VG_(HT_add_node)( mp->chunks, mc );        
+         mp_order_add(mp, mc);
       }
 
 #undef EXTENT_CONTAINS
@@ -1018,6 +1242,7 @@ void MC_(move_mempool)(Addr poolA, Addr poolB)
    }
 
    mp = VG_(HT_remove) ( MC_(mempool_list), (UWord)poolA );
+   last_mempool = NULL;
 
    if (mp == NULL) {
       ThreadId tid = VG_(get_running_tid)();
@@ -1041,32 +1266,39 @@ void MC_(mempool_change)(Addr pool, Addr addrA, Addr addrB, SizeT szB)
       VG_(get_and_pp_StackTrace) (tid, MEMPOOL_DEBUG_STACKTRACE_DEPTH);
    }
 
-   mp = VG_(HT_lookup)(MC_(mempool_list), (UWord)pool);
+   mp = find_mempool(pool);
    if (mp == NULL) {
       MC_(record_illegal_mempool_error)(tid, pool);
       return;
    }
 
-   check_mempool_sane(mp);
+   /* The sanity check sorts all the chunks of the pool.  As in
+      mempool_alloc and mempool_free, only do it when asked to. */
+   if (MP_DETAILED_SANITY_CHECKS) check_mempool_sane(mp);
 
    mc = VG_(HT_remove)(mp->chunks, (UWord)addrA);
    if (mc == NULL) {
       MC_(record_free_error)(tid, (Addr)addrA);
       return;
    }
+   mp_order_remove(mp, mc);
 
    mc->data = addrB;
    mc->szB  = szB;
    VG_(HT_add_node)( mp->chunks, mc );
+   extend_mempool_bounds(mp, addrB, szB);
 
-   check_mempool_sane(mp);
+   /* The changed chunk is checked against its neighbours only; if it
+      overlaps one of them, the full check reports the pool. */
+   if (!mp_order_add(mp, mc) || MP_DETAILED_SANITY_CHECKS)
+      check_mempool_sane(mp);
 }
 
 Bool MC_(mempool_exists)(Addr pool)
 {
    MC_Mempool*  mp;
 
-   mp = VG_(HT_lookup)(MC_(mempool_list), (UWord)pool);
+   mp = find_mempool(pool);
    if (mp == NULL) {
        return False;
    }
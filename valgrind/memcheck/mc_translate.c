@@ -174,6 +174,19 @@ typedef
    TempMapEnt;
 
 
+/* An entry in the PCast memo: 'res' is the PCast of shadow tmp 'src'
+   to shadow type 'ty'. */
+#define N_PCAST_MEMO 64
+
+typedef
+   struct {
+      IRTemp  src;
+      IRType  ty;
+      IRExpr* res;
+   }
+   PCastMemoEnt;
+
+
 /* Carries around state during memcheck instrumentation. */
 typedef
    struct _MCEnv {
@@ -216,6 +229,15 @@ typedef
          arguments of type 'HWord' to be passed to helper functions.
          Ity_I32 or Ity_I64 only. */
       IRType hWordTy;
+
+      /* MODIFIED: recently computed PCasts, direct-mapped on the
+         source tmp.  Shadow tmps are assigned only once, and an IRSB
+         is straight-line code, so a PCast computed earlier in the
+         block can be reused by any later statement.  The
+         post-instrumentation cleanup does no CSE, so without this the
+         same value gets PCast again for every use that needs it,
+         e.g. once per operation that consumes it. */
+      PCastMemoEnt pcastMemo[N_PCAST_MEMO];
    }
    MCEnv;
 
@@ -754,7 +776,7 @@ static IRAtom* mkImproveORV256 ( MCEnv* mce, IRAtom* data, IRAtom* vbits )
    is undefined (value == 1) the resulting expression has all bits set to
    1. Otherwise, all bits are 0. */
 
-static IRAtom* mkPCastTo( MCEnv* mce, IRType dst_ty, IRAtom* vbits ) 
+static IRAtom* mkPCastTo_WRK ( MCEnv* mce, IRType dst_ty, IRAtom* vbits )
 {
    IRType  src_ty;
    IRAtom* tmp1;
@@ -890,6 +912,26 @@ static IRAtom* mkPCastTo( MCEnv* mce, IRType dst_ty, IRAtom* vbits )
    }
 }
 
+static IRAtom* mkPCastTo( MCEnv* mce, IRType dst_ty, IRAtom* vbits ) 
+{
+   PCastMemoEnt* ent;
+   IRAtom*       res;
+
+   if (vbits->tag != Iex_RdTmp)
+      return mkPCastTo_WRK(mce, dst_ty, vbits);
+
+   ent = &mce->pcastMemo[(vbits->Iex.RdTmp.tmp * 7 + dst_ty)
+                         % N_PCAST_MEMO];
+   if (ent->src == vbits->Iex.RdTmp.tmp && ent->ty == dst_ty)
+      return ent->res;
+
+   res = mkPCastTo_WRK(mce, dst_ty, vbits);
+   ent->src = vbits->Iex.RdTmp.tmp;
+   ent->ty  = dst_ty;
+   ent->res = res;
+   return res;
+}
+
 /* This is a minor variant.  It takes an arg of some type and returns
    a value of the same type.  The result consists entirely of Defined
    (zero) bits except its least significant bit, which is a PCast of
@@ -4606,6 +4648,142 @@ IRExpr* expr2vbits_Unop ( MCEnv* mce, IROp op, IRAtom* atom )
 }
 
 
+/* Inline fast paths for shadow loads and stores.
+
+   Most 4- and 8-byte accesses are aligned, fall in the part of the
+   address space covered by the primary map, and touch memory that is
+   entirely addressable and defined.  The LOADV/STOREV helpers handle
+   that case in a handful of instructions, but the call itself (saving
+   and restoring caller-saved registers) costs more than the work.  So
+   for those sizes we generate the same test inline:
+
+      bad = (a & (high_mask | (szB-1)))
+            | (vabits(primary_map[(a >> 16) & ix_mask], a) ^ DEFINED)
+            [ | vdata, for a store ]
+
+   and call the helper only when |bad| is nonzero.  For a load, the
+   result is then all-defined; for a store of defined data over
+   defined memory, there is nothing to do.
+
+   The index is masked, so the primary map entry loaded is always a
+   valid secondary (possibly a distinguished one), whatever the value
+   of |a|; the out-of-range case is caught by high_mask instead.  The
+   shadow loads are plain IR loads, which iropt will not CSE across the
+   helper calls (dirty calls invalidate all available loads).
+
+   gen_fast_shadow_test returns an Ity_I1 atom, True when the fast
+   path applies and |guard| (if non-NULL) is True, and sets *slow to
+   an Ity_I1 atom which is True when the helper has to be called.
+   Returns NULL when no fast path can be generated for this access. */
+static
+IRAtom* gen_fast_shadow_test ( MCEnv* mce, IRAtom* addrAct, Int szB,
+                               IRAtom* vdata, IRAtom* guard,
+                               /*OUT*/IRAtom** slow )
+{
+   Addr    pm;
+   UWord   ix_mask, high_mask;
+   IRType  tyW   = mce->hWordTy;
+   Bool    is64  = tyW == Ity_I64;
+   IROp    opAnd = is64 ? Iop_And64 : Iop_And32;
+   IROp    opOr  = is64 ? Iop_Or64  : Iop_Or32;
+   IROp    opXor = is64 ? Iop_Xor64 : Iop_Xor32;
+   IROp    opShr = is64 ? Iop_Shr64 : Iop_Shr32;
+   IROp    opShl = is64 ? Iop_Shl64 : Iop_Shl32;
+   IROp    opAdd = is64 ? Iop_Add64 : Iop_Add32;
+   IROp    opSub = is64 ? Iop_Sub64 : Iop_Sub32;
+   IROp    opEQ  = is64 ? Iop_CmpEQ64 : Iop_CmpEQ32;
+   IROp    opNE  = is64 ? Iop_CmpNE64 : Iop_CmpNE32;
+   IRAtom  *ix, *smp, *sm, *off, *vab, *bad, *fast;
+   IREndness hend;
+
+#  define mkW(_n) (is64 ? mkU64(_n) : mkU32(_n))
+
+#  if defined(VG_BIGENDIAN)
+   hend = Iend_BE;
+#  else
+   hend = Iend_LE;
+#  endif
+
+   tl_assert(tyW == Ity_I32 || tyW == Ity_I64);
+   if (szB != 4 && szB != 8)
+      return NULL;
+   /* An 8-byte store on a 32-bit host would need its V bits split in
+      two; not worth it. */
+   if (szB == 8 && !is64)
+      return NULL;
+   if (!MC_(get_primary_map_info)(&pm, &ix_mask, &high_mask))
+      return NULL;
+
+   /* sm = primary_map[(a >> 16) & ix_mask] */
+   ix  = assignNew('V', mce, tyW,
+                   binop(opAnd, assignNew('V', mce, tyW,
+                                          binop(opShr, addrAct, mkU8(16))),
+                                mkW(ix_mask)));
+   smp = assignNew('V', mce, tyW,
+                   binop(opAdd, mkW(pm),
+                                assignNew('V', mce, tyW,
+                                          binop(opShl, ix,
+                                                mkU8(is64 ? 3 : 2)))));
+   sm  = assignNew('V', mce, tyW, IRExpr_Load(hend, tyW, smp));
+
+   /* vab = the V+A bits of a .. a+szB-1, at byte offset
+      (a & 0xFFFF) >> 2 in the secondary, rounded down to szB. */
+   off = assignNew('V', mce, tyW,
+                   binop(opShr, assignNew('V', mce, tyW,
+                                          binop(opAnd, addrAct,
+                                                mkW(0x10000 - szB))),
+                                mkU8(2)));
+   if (szB == 8) {
+      vab = assignNew('V', mce, Ity_I16,
+                      IRExpr_Load(hend, Ity_I16,
+                                  assignNew('V', mce, tyW,
+                                            binop(opAdd, sm, off))));
+      vab = assignNew('V', mce, tyW,
+                      unop(is64 ? Iop_16Uto64 : Iop_16Uto32, vab));
+      vab = assignNew('V', mce, tyW, binop(opXor, vab, mkW(0xAAAA)));
+   } else {
+      vab = assignNew('V', mce, Ity_I8,
+                      IRExpr_Load(hend, Ity_I8,
+                                  assignNew('V', mce, tyW,
+                                            binop(opAdd, sm, off))));
+      vab = assignNew('V', mce, tyW,
+                      unop(is64 ? Iop_8Uto64 : Iop_8Uto32, vab));
+      vab = assignNew('V', mce, tyW, binop(opXor, vab, mkW(0xAA)));
+   }
+
+   bad = assignNew('V', mce, tyW,
+                   binop(opAnd, addrAct, mkW(high_mask | (szB - 1))));
+   bad = assignNew('V', mce, tyW, binop(opOr, bad, vab));
+   if (vdata) {
+      if (szB == 4 && is64)
+         vdata = assignNew('V', mce, tyW, unop(Iop_32Uto64, vdata));
+      bad = assignNew('V', mce, tyW, binop(opOr, bad, vdata));
+   }
+
+   if (guard) {
+      /* fast = guard && bad == 0;  slow = guard && bad != 0 */
+      IRAtom* g = assignNew('V', mce, tyW,
+                            unop(is64 ? Iop_1Uto64 : Iop_1Uto32, guard));
+      IRAtom* notg = assignNew('V', mce, tyW, binop(opXor, g, mkW(1)));
+      IRAtom* gmask = assignNew('V', mce, tyW, binop(opSub, mkW(0), g));
+      fast  = assignNew('V', mce, Ity_I1,
+                        binop(opEQ, assignNew('V', mce, tyW,
+                                              binop(opOr, bad, notg)),
+                                    mkW(0)));
+      *slow = assignNew('V', mce, Ity_I1,
+                        binop(opNE, assignNew('V', mce, tyW,
+                                              binop(opAnd, bad, gmask)),
+                                    mkW(0)));
+   } else {
+      fast  = assignNew('V', mce, Ity_I1, binop(opEQ, bad, mkW(0)));
+      *slow = assignNew('V', mce, Ity_I1, unop(Iop_Not1, fast));
+   }
+   return fast;
+
+#  undef mkW
+}
+
+
 /* Worker function -- do not call directly.  See comments on
    expr2vbits_Load for the meaning of |guard|.
 
@@ -4727,8 +4905,17 @@ IRAtom* expr2vbits_Load_WRK ( MCEnv* mce,
                               mkIRExprVec_1( addrAct ) );
    }
 
+   /* Try to avoid the call in the common case. */
+   IRAtom* slow = NULL;
+   IRAtom* fast = NULL;
+   if (ty == Ity_I64 || ty == Ity_I32)
+      fast = gen_fast_shadow_test( mce, addrAct, sizeofIRType(ty),
+                                   NULL, guard, &slow );
+
    setHelperAnns( mce, di );
-   if (guard) {
+   if (fast) {
+      di->guard = slow;
+   } else if (guard) {
       di->guard = guard;
       /* Ideally the didn't-happen return value here would be all-ones
          (all-undefined), so it'd be obvious if it got used
@@ -4738,6 +4925,13 @@ IRAtom* expr2vbits_Load_WRK ( MCEnv* mce,
    }
    stmt( 'V', mce, IRStmt_Dirty(di) );
 
+   if (fast) {
+      /* If |guard| is False, so is |fast|, and the result is the
+         didn't-happen value from the (not done) call, as above. */
+      return assignNew('V', mce, ty,
+                       IRExpr_ITE(fast, definedOfType(ty),
+                                        mkexpr(datavbits)));
+   }
    return mkexpr(datavbits);
 }
 
@@ -5240,6 +5434,14 @@ void do_shadow_Store ( MCEnv* mce,
          addrAct = assignNew('V', mce, tyAddr, binop(mkAdd, addr, eBias));
       }
 
+      /* In the common case there is nothing to do; see
+         gen_fast_shadow_test. */
+      IRAtom* slow = NULL;
+      IRAtom* fast = NULL;
+      if (ty == Ity_I64 || ty == Ity_I32)
+         fast = gen_fast_shadow_test( mce, addrAct, sizeofIRType(ty),
+                                      vdata, guard, &slow );
+
       if (ty == Ity_I64) {
          /* We can't do this with regparm 2 on 32-bit platforms, since
             the back ends aren't clever enough to handle 64-bit
@@ -5257,7 +5459,10 @@ void do_shadow_Store ( MCEnv* mce,
                                 zwidenToHostWord( mce, vdata ))
               );
       }
-      if (guard) di->guard = guard;
+      if (fast)
+         di->guard = slow;
+      else if (guard)
+         di->guard = guard;
       setHelperAnns( mce, di );
       stmt( 'V', mce, IRStmt_Dirty(di) );
    }
@@ -6290,6 +6495,8 @@ IRSB* MC_(instrument) ( VgCallbackClosure* closure,
    mce.layout         = layout;
    mce.hWordTy        = hWordTy;
    mce.bogusLiterals  = False;
+   for (i = 0; i < N_PCAST_MEMO; i++)
+      mce.pcastMemo[i].src = IRTemp_INVALID;
 
    /* Do expensive interpretation for Iop_Add32 and Iop_Add64 on
       Darwin.  10.7 is mostly built with LLVM, which uses these for
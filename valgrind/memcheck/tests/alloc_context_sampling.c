@@ -0,0 +1,33 @@
+/* With --alloc-context-sampling=4, about one block in 4 has its full
+   stack recorded.  So of the 40 blocks leaked here, some are reported
+   with the full stack, and the others with the short context: the
+   allocator, its caller, and a note. */
+
+#include <stdlib.h>
+
+#define N_BLOCKS 40
+
+static char* volatile blocks[N_BLOCKS];
+
+__attribute__((noinline))
+static char* alloc_block ( void )
+{
+   return malloc(10);
+}
+
+__attribute__((noinline))
+static char* make_block ( void )
+{
+   return alloc_block();
+}
+
+int main ( void )
+{
+   int i;
+
+   for (i = 0; i < N_BLOCKS; i++)
+      blocks[i] = make_block();
+   for (i = 0; i < N_BLOCKS; i++)
+      blocks[i] = NULL;
+   return 0;
+}
@@ -0,0 +1,33 @@
+// The demangled name of f below is more than 64KB long, although its
+// mangled name is short, since the demangler expands substitutions.
+// Printing it must not crash the demangler's cache, nor spoil the
+// demangling of the names that come after it.
+
+template <typename A, typename B> struct P { };
+
+template <int N> struct T {
+   typedef P<typename T<N-1>::type, typename T<N-1>::type> type;
+};
+template <> struct T<0> { typedef int type; };
+
+template <typename X>
+__attribute__((noinline)) int f ( X, int* p )
+{
+   return *p ? 10 : 20;
+}
+
+template <typename X>
+__attribute__((noinline)) int g ( X* p )
+{
+   return *p ? 10 : 20;
+}
+
+int main ( void )
+{
+   int* p = new int;
+   f(T<14>::type(), p);
+   f(T<14>::type(), p);
+   g(p);
+   delete p;
+   return 0;
+}
@@ -0,0 +1,30 @@
+// VALGRIND_MEMPOOL_CHANGE must still report a chunk that it moves on
+// top of another chunk of the same pool, and must not report moves
+// that keep the chunks apart.
+
+#include "../memcheck.h"
+
+static char pool[1024];
+
+int main ( void )
+{
+   char* a = pool;
+   char* b = pool + 64;
+   char* c = pool + 128;
+
+   VALGRIND_CREATE_MEMPOOL(pool, 0, 0);
+   VALGRIND_MEMPOOL_ALLOC(pool, a, 32);
+   VALGRIND_MEMPOOL_ALLOC(pool, b, 32);
+   VALGRIND_MEMPOOL_ALLOC(pool, c, 32);
+
+   // Grow b in place, and move c up: no overlap.
+   VALGRIND_MEMPOOL_CHANGE(pool, b, b, 64);
+   c = pool + 256;
+   VALGRIND_MEMPOOL_CHANGE(pool, pool + 128, c, 32);
+
+   // Grow a over the start of b.
+   VALGRIND_MEMPOOL_CHANGE(pool, a, a, 80);
+
+   VALGRIND_DESTROY_MEMPOOL(pool);
+   return 0;
+}
@@ -0,0 +1,31 @@
+/* Each 64KB secondary map of an mmap'd area is made undefined in two
+   halves.  The first half makes Memcheck give it a secondary of its
+   own; after the second half it is uniform again, and is reclaimed if
+   --secmap-huge-pages=yes.  So n_reclaimed in the stats must be at
+   least N_CHUNKS with that option, and 0 without it. */
+
+#include <assert.h>
+#include <stdint.h>
+#include "tests/sys_mman.h"
+#include "../memcheck.h"
+
+#define CHUNK    (64 * 1024)
+#define N_CHUNKS 16
+
+int main ( void )
+{
+   char* m = mmap(NULL, (N_CHUNKS + 1) * CHUNK, PROT_READ|PROT_WRITE,
+                  MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+   char* p;
+   int   i;
+
+   assert(m != MAP_FAILED);
+   p = (char*)(((uintptr_t)m + CHUNK - 1) & ~(uintptr_t)(CHUNK - 1));
+   for (i = 0; i < N_CHUNKS; i++) {
+      (void) VALGRIND_MAKE_MEM_UNDEFINED(p + i * CHUNK, CHUNK / 2);
+      (void) VALGRIND_MAKE_MEM_UNDEFINED(p + i * CHUNK + CHUNK / 2,
+                                         CHUNK / 2);
+   }
+   munmap(m, (N_CHUNKS + 1) * CHUNK);
+   return 0;
+}
@@ -0,0 +1,75 @@
+/* The errors below have stacks that share their inner frames but not
+   their outer ones, or that put different code at the same stack
+   addresses, as happens when code is unmapped and other code runs in
+   its place, or that go through a signal frame.  With
+   --stack-trace-cache=yes they must get the same stacks as with
+   --stack-trace-cache=no. */
+
+#include <signal.h>
+#include <stdlib.h>
+
+static int* volatile undef;
+static volatile int  sink;
+
+__attribute__((noinline))
+static void err ( void )
+{
+   if (*undef)
+      sink++;
+   sink++;
+}
+
+__attribute__((noinline))
+static void via_a ( void )
+{
+   err();
+   sink++;
+}
+
+__attribute__((noinline))
+static void via_b ( void )
+{
+   err();
+   sink++;
+}
+
+__attribute__((noinline))
+static void recurse ( int n )
+{
+   if (n == 0)
+      err();
+   else
+      recurse(n - 1);
+   sink++;
+}
+
+static void handler ( int sig )
+{
+   err();
+   sink++;
+}
+
+int main ( void )
+{
+   void (*fns[2])(void) = { via_a, via_b };
+   int i;
+
+   undef = malloc(sizeof(int));
+
+   /* The same frames at the same stack addresses, but different code. */
+   for (i = 0; i < 4; i++)
+      fns[i % 2]();
+
+   /* The same inner frames at different depths. */
+   for (i = 0; i < 4; i++)
+      recurse(i);
+
+   /* A signal frame between err and main. */
+   signal(SIGUSR1, handler);
+   raise(SIGUSR1);
+
+   err();
+
+   free(undef);
+   return 0;
+}
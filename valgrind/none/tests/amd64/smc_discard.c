@@ -0,0 +1,61 @@
+/* Test --smc-check=mprotect when translations are discarded without
+   the mapping changing.  After VALGRIND_DISCARD_TRANSLATIONS on a
+   write-protected code page, the page must still be writable, both
+   for new code written by the program and for code written while the
+   old translation is still in use.
+
+   CORRECT output is
+
+      code returns 1
+      code returns 2
+      code returns 3
+
+   WRONG output is a SIGSEGV on the write after the discard (if the
+   page was left protected), or "code returns 1" again (if a stale
+   translation was run).
+*/
+
+#include <stdio.h>
+#include <assert.h>
+#include "tests/sys_mman.h"
+#include "../../../include/valgrind.h"
+
+typedef unsigned char UChar;
+
+/* Make code at P be  movl $n, %eax ; ret */
+static void set_ret ( UChar* p, int n )
+{
+   p[0] = 0xB8;
+   p[1] = n & 0xFF;
+   p[2] = (n >> 8) & 0xFF;
+   p[3] = (n >> 16) & 0xFF;
+   p[4] = (n >> 24) & 0xFF;
+   p[5] = 0xC3;
+}
+
+__attribute__((noinline))
+static int call ( UChar* p ) { return ((int(*)(void))p)(); }
+
+int main ( void )
+{
+   UChar* code = mmap(NULL, 4096, PROT_READ|PROT_WRITE|PROT_EXEC,
+                      MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+   assert(code != MAP_FAILED);
+
+   set_ret(code, 1);
+   printf("code returns %d\n", call(code));
+
+   /* The page is write-protected now.  Discarding its translations
+      must not leave it so. */
+   VALGRIND_DISCARD_TRANSLATIONS(code, 4096);
+   set_ret(code, 2);
+   printf("code returns %d\n", call(code));
+
+   /* And rewriting code that has just been translated again must not
+      run the old translation. */
+   set_ret(code, 3);
+   printf("code returns %d\n", call(code));
+
+   munmap(code, 4096);
+   return 0;
+}
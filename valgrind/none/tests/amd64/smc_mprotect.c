@@ -0,0 +1,65 @@
+/* Test --smc-check=mprotect when the program itself calls mprotect on
+   a page it has run code from.  The kernel then drops the write
+   protection Valgrind put on the page, so the page's translations
+   must be discarded, or else rewriting the code goes unnoticed.
+
+   CORRECT output is
+
+      code returns 1
+      code returns 2
+      code returns 2
+      code returns 3
+
+   WRONG output is "code returns 1" twice, or "code returns 2" three
+   times (if a stale translation was run).
+*/
+
+#include <stdio.h>
+#include <assert.h>
+#include "tests/sys_mman.h"
+
+typedef unsigned char UChar;
+
+/* Make code at P be  movl $n, %eax ; ret */
+static void set_ret ( UChar* p, int n )
+{
+   p[0] = 0xB8;
+   p[1] = n & 0xFF;
+   p[2] = (n >> 8) & 0xFF;
+   p[3] = (n >> 16) & 0xFF;
+   p[4] = (n >> 24) & 0xFF;
+   p[5] = 0xC3;
+}
+
+__attribute__((noinline))
+static int call ( UChar* p ) { return ((int(*)(void))p)(); }
+
+int main ( void )
+{
+   int r;
+   UChar* code = mmap(NULL, 4096, PROT_READ|PROT_WRITE|PROT_EXEC,
+                      MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+   assert(code != MAP_FAILED);
+
+   set_ret(code, 1);
+   printf("code returns %d\n", call(code));
+
+   /* Setting the permissions the page already has makes it
+      writable again as far as the kernel is concerned. */
+   r = mprotect(code, 4096, PROT_READ|PROT_WRITE|PROT_EXEC);
+   assert(r == 0);
+   set_ret(code, 2);
+   printf("code returns %d\n", call(code));
+
+   /* Likewise going from read-execute to read-write-execute. */
+   r = mprotect(code, 4096, PROT_READ|PROT_EXEC);
+   assert(r == 0);
+   printf("code returns %d\n", call(code));
+   r = mprotect(code, 4096, PROT_READ|PROT_WRITE|PROT_EXEC);
+   assert(r == 0);
+   set_ret(code, 3);
+   printf("code returns %d\n", call(code));
+
+   munmap(code, 4096);
+   return 0;
+}
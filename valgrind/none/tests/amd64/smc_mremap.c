@@ -0,0 +1,61 @@
+/* Test --smc-check=mprotect when a page it has write-protected is
+   moved by mremap.  The kernel moves the page with its protection, so
+   unless Valgrind makes the page writable again first, the program's
+   next write to it faults.
+
+   CORRECT output is
+
+      code returns 1
+      code returns 2
+      code returns 3
+
+   WRONG output is a SIGSEGV on the write after the move, or "code
+   returns 2" twice (if the moved page was not protected again).
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <assert.h>
+#include "tests/sys_mman.h"
+
+typedef unsigned char UChar;
+
+/* Make code at P be  movl $n, %eax ; ret */
+static void set_ret ( UChar* p, int n )
+{
+   p[0] = 0xB8;
+   p[1] = n & 0xFF;
+   p[2] = (n >> 8) & 0xFF;
+   p[3] = (n >> 16) & 0xFF;
+   p[4] = (n >> 24) & 0xFF;
+   p[5] = 0xC3;
+}
+
+__attribute__((noinline))
+static int call ( UChar* p ) { return ((int(*)(void))p)(); }
+
+int main ( void )
+{
+#if defined(MREMAP_FIXED)
+   UChar* code = mmap(NULL, 4096, PROT_READ|PROT_WRITE|PROT_EXEC,
+                      MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+   UChar* moved = get_unmapped_page();
+   assert(code != MAP_FAILED);
+
+   set_ret(code, 1);
+   printf("code returns %d\n", call(code));
+
+   /* The page is write-protected now.  Move it elsewhere. */
+   code = mremap(code, 4096, 4096, MREMAP_MAYMOVE|MREMAP_FIXED, moved);
+   assert(code == moved);
+   set_ret(code, 2);
+   printf("code returns %d\n", call(code));
+
+   /* And code run from the new place must still be checked. */
+   set_ret(code, 3);
+   printf("code returns %d\n", call(code));
+
+   munmap(code, 4096);
+#endif
+   return 0;
+}
@@ -0,0 +1,99 @@
+/* Test --smc-check=mprotect when the kernel writes code.  One thread
+   read()s new code from a pipe into a page that holds translated code,
+   while a second thread keeps running other code from the same page,
+   so that Valgrind would like to write-protect the page again while
+   the read() is blocked.  The read must still succeed, and the new
+   code must be the code that runs afterwards.
+
+   CORRECT output is
+
+      read 6 bytes
+      code returns 2
+
+   WRONG output (if the page was protected under the read()) is
+
+      read failed: Bad address
+      code returns 1
+*/
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include "tests/sys_mman.h"
+
+typedef unsigned char UChar;
+
+static UChar* code;
+static int    fds[2];
+static ssize_t n_read;
+static int    read_errno;
+static volatile int done;
+
+/* Make code at P be  movl $n, %eax ; ret */
+static void set_ret ( UChar* p, int n )
+{
+   p[0] = 0xB8;
+   p[1] = n & 0xFF;
+   p[2] = (n >> 8) & 0xFF;
+   p[3] = (n >> 16) & 0xFF;
+   p[4] = (n >> 24) & 0xFF;
+   p[5] = 0xC3;
+}
+
+__attribute__((noinline))
+static int call ( UChar* p ) { return ((int(*)(void))p)(); }
+
+static void* reader ( void* v )
+{
+   n_read = read(fds[0], code, 6);
+   read_errno = errno;
+   return NULL;
+}
+
+static void* runner ( void* v )
+{
+   while (!done) {
+      assert(call(code + 64) == 7);
+      usleep(1000);
+   }
+   return NULL;
+}
+
+int main ( void )
+{
+   pthread_t r, s;
+   UChar     new_code[6];
+
+   code = mmap(NULL, 4096, PROT_READ|PROT_WRITE|PROT_EXEC,
+               MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+   assert(code != MAP_FAILED);
+   set_ret(code, 1);
+   set_ret(code + 64, 7);
+   assert(call(code) == 1);
+   assert(call(code + 64) == 7);
+
+   assert(pipe(fds) == 0);
+   pthread_create(&r, NULL, reader, NULL);
+   pthread_create(&s, NULL, runner, NULL);
+
+   /* Give the reader time to block in read(), and the runner time to
+      translate code from the page again. */
+   usleep(200000);
+   set_ret(new_code, 2);
+   assert(write(fds[1], new_code, 6) == 6);
+   pthread_join(r, NULL);
+   done = 1;
+   pthread_join(s, NULL);
+
+   if (n_read < 0)
+      printf("read failed: %s\n", strerror(read_errno));
+   else
+      printf("read %d bytes\n", (int)n_read);
+   printf("code returns %d\n", call(code));
+
+   munmap(code, 4096);
+   return 0;
+}
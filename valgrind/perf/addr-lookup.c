@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+// addr-lookup makes Valgrind look up a lot of code addresses in the
+// debug info.  It has 900 functions, each of which reaches a common leaf
+// through a call chain of its own.  The leaf allocates a block, so that
+// the tool unwinds the stack through many different frames, and branches
+// on an undefined value, so that Memcheck reports one error per function
+// and turns every frame of it into a function name, file and line.
+//
+// usage: addr-lookup [nr_rounds default 10] [depth default 8]
+
+typedef int (*fn_t)(char *, int);
+
+static volatile int sink;
+static fn_t fns[900];
+
+__attribute__((noinline))
+static int leaf(char *u, int n)
+{
+   char *p = malloc(16 + n % 64);
+   if (u[n % 16] == 'x')      // u is never initialised
+      sink++;
+   free(p);
+   return n & 1;
+}
+
+__attribute__((noinline))
+static int call(char *u, int n, int d)
+{
+   // An indirect call, so the compiler cannot flatten the chain.
+   return fns[n - 100](u, d);
+}
+
+#define F(n) \
+   __attribute__((noinline)) \
+   static int f##n(char *u, int d) \
+   { return d == 0 ? leaf(u, n) : call(u, n, d - 1) + 1; }
+
+#define T(n) fns[n - 100] = f##n;
+
+#define R10(M,p)  M(p##0) M(p##1) M(p##2) M(p##3) M(p##4) \
+                  M(p##5) M(p##6) M(p##7) M(p##8) M(p##9)
+#define R100(M,p) R10(M,p##0) R10(M,p##1) R10(M,p##2) R10(M,p##3) \
+                  R10(M,p##4) R10(M,p##5) R10(M,p##6) R10(M,p##7) \
+                  R10(M,p##8) R10(M,p##9)
+#define R900(M)   R100(M,1) R100(M,2) R100(M,3) R100(M,4) R100(M,5) \
+                  R100(M,6) R100(M,7) R100(M,8) R100(M,9)
+
+R900(F)
+
+int main(int argc, char *argv[])
+{
+   int nr_rounds = argc > 1 ? atoi(argv[1]) : 10;
+   int depth     = argc > 2 ? atoi(argv[2]) : 8;
+   char *u = malloc(16);
+   int r, i;
+   long sum = 0;
+
+   R900(T)
+
+   for (r = 0; r < nr_rounds; r++)
+      for (i = 0; i < 900; i++)
+         sum += fns[i](u, depth);
+   printf("%d rounds, depth %d: %ld\n", nr_rounds, depth, sum);
+
+   free(u);
+   return 0;
+}
@@ -0,0 +1,111 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// many-threads runs a number of threads that are all busy at the same
+// time, as a server with a thread pool does under load.  Each thread
+// alternates between a short burst of computation and handing a token
+// to its neighbour through a mutex/condition variable pair, so that the
+// time Valgrind needs to pass the CPU from one thread to another shows
+// up directly in the run time.
+//
+// usage: many-threads [-t nr_threads default 32]
+//                     [-r nr_rounds default 2000]
+//                     [-w work_per_round default 2000]
+
+static int nr_thr;
+static int nr_rounds;
+static int work;
+
+typedef struct {
+   pthread_mutex_t mx;
+   pthread_cond_t  cv;
+   int             tokens;
+} slot_t;
+
+static slot_t *slots;
+static unsigned long *sums;
+
+static void give(slot_t *s)
+{
+   pthread_mutex_lock(&s->mx);
+   s->tokens++;
+   pthread_cond_signal(&s->cv);
+   pthread_mutex_unlock(&s->mx);
+}
+
+static void take(slot_t *s)
+{
+   pthread_mutex_lock(&s->mx);
+   while (s->tokens == 0)
+      pthread_cond_wait(&s->cv, &s->mx);
+   s->tokens--;
+   pthread_mutex_unlock(&s->mx);
+}
+
+static void *thr_fn(void *v)
+{
+   int me = (int)(long)v;
+   int r, i;
+   unsigned long sum = me;
+
+   for (r = 0; r < nr_rounds; r++) {
+      take(&slots[me]);
+      for (i = 0; i < work; i++)
+         sum = sum * 1103515245 + 12345 + i;
+      give(&slots[(me + 1) % nr_thr]);
+   }
+   sums[me] = sum;
+   return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+   int a, i;
+   pthread_t *thr;
+   unsigned long total = 0;
+
+   nr_thr = 32;
+   nr_rounds = 2000;
+   work = 2000;
+   for (a = 1; a + 1 < argc; a += 2) {
+      if        (strcmp(argv[a], "-t") == 0) {
+         nr_thr = atoi(argv[a+1]);
+      } else if (strcmp(argv[a], "-r") == 0) {
+         nr_rounds = atoi(argv[a+1]);
+      } else if (strcmp(argv[a], "-w") == 0) {
+         work = atoi(argv[a+1]);
+      } else {
+         printf("unknown arg %s\n", argv[a]);
+      }
+   }
+   if (nr_thr < 1)
+      nr_thr = 1;
+
+   slots = calloc(nr_thr, sizeof(*slots));
+   sums  = calloc(nr_thr, sizeof(*sums));
+   thr   = calloc(nr_thr, sizeof(*thr));
+   for (i = 0; i < nr_thr; i++) {
+      pthread_mutex_init(&slots[i].mx, NULL);
+      pthread_cond_init(&slots[i].cv, NULL);
+      // A few tokens circulate, so several threads are runnable at once.
+      slots[i].tokens = (i % 4 == 0);
+   }
+
+   for (i = 0; i < nr_thr; i++)
+      if (pthread_create(&thr[i], NULL, thr_fn, (void *)(long)i) != 0)
+         perror("pthread_create");
+   for (i = 0; i < nr_thr; i++)
+      if (pthread_join(thr[i], NULL) != 0)
+         perror("pthread_join");
+
+   for (i = 0; i < nr_thr; i++)
+      total += sums[i];
+   printf("%d threads, %d rounds: %lx\n", nr_thr, nr_rounds, total);
+
+   free(thr);
+   free(sums);
+   free(slots);
+   return 0;
+}